@@ -0,0 +1,198 @@
+import os
+import sys
+import shutil
+import subprocess
+import tempfile
+import time
+
+# Runs every implementation of the compiler on the same generated programs, checks the
+# objects they write behave the same once linked, and compares how fast they got there.
+#
+#   python3 bench/compare.py [--sizes=1000,4000] [--repeat=3] [--only=c,c++,python,julia]
+#
+# --sizes are assignment counts for the generator; the table counts declarations and prints too.
+
+Root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+Generator = os.path.join(Root, 'c++', 'build', 'generate.out')
+
+class Implementation:
+    def __init__(self, name, build, command, output, braces):
+        self.name = name
+        self.build = build          # Command run in the repo root first, None if there's nothing to build
+        self.command = command      # Compiler command, the input file is appended
+        self.output = output        # Object file it writes into its working directory
+        self.braces = braces        # Programs must be a compound statement
+        self.skipped = None
+
+Implementations = [
+    Implementation('c', ['make', '-C', 'c'], [os.path.join(Root, 'c', 'build', 'compiler.out')], 'output.o', False),
+    Implementation('c++', ['make', '-C', 'c++'], [os.path.join(Root, 'c++', 'build', 'compiler.out')], 'output.o', False),
+    Implementation('python', None, [sys.executable, os.path.join(Root, 'python', 'main.py')], 'out.o', True),
+    Implementation('julia', None, ['julia', '--project=' + os.path.join(Root, 'julia'), '-e', 'using CCompiler'], 'output.o', False),
+]
+
+def usage(prog):
+    print('Usage: %s [--sizes=N,...] [--repeat=N] [--only=NAME,...]' % prog, file=sys.stderr)
+    sys.exit(1)
+
+# Writes a program with this many assignments, returning how many statements it has in all. Every
+# statement the generator writes ends in a semicolon, so this is statement_count in c++/bench/workload.hpp
+def generate(assignments, path):
+    with open(path, 'w') as outFile:
+        subprocess.run([Generator, '--assignments=%d' % assignments], stdout=outFile, check=True)
+
+    with open(path) as inFile:
+        return inFile.read().count(';')
+
+def source_for(impl, path, workdir):
+    if not impl.braces:
+        return path
+
+    # The Python port parses a single compound statement
+    wrapped = os.path.join(workdir, 'braced.c')
+
+    with open(path) as inFile, open(wrapped, 'w') as outFile:
+        outFile.write('{\n' + inFile.read() + '}\n')
+
+    return wrapped
+
+def measure(command, cwd):
+    # Wall time and peak RSS of one run, from the child's own rusage
+    start = time.perf_counter()
+    proc = subprocess.Popen(command, cwd=cwd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = proc.stderr.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    elapsed = time.perf_counter() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+
+    if proc.returncode != 0:
+        raise RuntimeError(stderr.decode(errors='replace').strip() or 'exit status %d' % proc.returncode)
+
+    return elapsed, usage.ru_maxrss
+
+def compile_once(impl, path, workdir):
+    obj = os.path.join(workdir, impl.output)
+
+    if os.path.exists(obj):
+        os.remove(obj)
+
+    elapsed, rss = measure(impl.command + [source_for(impl, path, workdir)], workdir)
+
+    if not os.path.exists(obj):
+        raise RuntimeError('no %s written' % impl.output)
+
+    return elapsed, rss, obj
+
+def program_output(obj, workdir):
+    exe = os.path.join(workdir, 'a.out')
+    subprocess.run(['cc', obj, '-no-pie', '-o', exe], check=True, capture_output=True)
+    return subprocess.run([exe], check=True, capture_output=True).stdout
+
+def prepare(impl, workdir, empty):
+    if impl.build:
+        result = subprocess.run(impl.build, cwd=Root, capture_output=True)
+
+        if result.returncode != 0:
+            impl.skipped = 'build failed'
+            return
+
+    if not shutil.which(impl.command[0]):
+        impl.skipped = '%s not found' % os.path.basename(impl.command[0])
+        return
+
+    # First run also pays for one-off work like Julia's precompilation
+    try:
+        compile_once(impl, empty, workdir)
+    except RuntimeError as e:
+        impl.skipped = str(e).splitlines()[-1]
+
+def main():
+    sizes = [1000, 4000]
+    repeat = 3
+    only = None
+
+    for arg in sys.argv[1:]:
+        name, _, value = arg.partition('=')
+
+        try:
+            if name == '--sizes':
+                sizes = [int(s) for s in value.split(',')]
+            elif name == '--repeat':
+                repeat = int(value)
+            elif name == '--only':
+                only = value.split(',')
+            else:
+                usage(sys.argv[0])
+        except ValueError:
+            usage(sys.argv[0])
+
+    impls = [impl for impl in Implementations if (only == None) or (impl.name in only)]
+
+    if (not impls) or (repeat < 1) or (min(sizes) < 1):
+        usage(sys.argv[0])
+
+    subprocess.run(['make', '-C', os.path.join(Root, 'c++'), 'build/generate.out'], check=True, capture_output=True)
+    workdir = tempfile.mkdtemp(prefix='compare')
+
+    try:
+        empty = os.path.join(workdir, 'empty.c')
+
+        with open(empty, 'w') as outFile:
+            outFile.write('int a;\na = 0;\nprint a;\n')
+
+        for impl in impls:
+            prepare(impl, workdir, empty)
+
+        rows = {impl.name: [] for impl in impls}
+        startup = {}
+        expected = {}
+
+        for impl in impls:
+            if impl.skipped == None:
+                startup[impl.name] = min(compile_once(impl, empty, workdir)[0] for _ in range(repeat))
+
+        for size in sizes:
+            path = os.path.join(workdir, 'program%d.c' % size)
+            statements = generate(size, path)
+            length = os.path.getsize(path)
+
+            for impl in impls:
+                if impl.skipped != None:
+                    continue
+
+                try:
+                    runs = [compile_once(impl, path, workdir) for _ in range(repeat)]
+                except RuntimeError as e:
+                    rows[impl.name].append((statements, None, None, None, 'failed: %s' % str(e).splitlines()[-1]))
+                    continue
+
+                # The first implementation to get this far sets what the others must print
+                output = program_output(runs[-1][2], workdir)
+                expected.setdefault(size, output)
+                check = 'ok' if output == expected[size] else 'MISMATCH'
+                best = min(r[0] for r in runs)
+                rss = max(r[1] for r in runs)
+                rows[impl.name].append((statements, best, length / best / 1e6, rss / 1024, check))
+
+        print('%-8s %10s %10s %10s %10s %10s %12s %8s' % ('impl', 'startup ms', 'stmts', 'time ms', 'MB/s', 'stmts/s', 'peak RSS MB', 'output'))
+        print('-' * 86)
+
+        for impl in impls:
+            if impl.skipped != None:
+                print('%-8s skipped: %s' % (impl.name, impl.skipped))
+                continue
+
+            for statements, best, rate, rss, check in rows[impl.name]:
+                if best == None:
+                    print('%-8s %10.1f %10d %s' % (impl.name, startup[impl.name] * 1e3, statements, check))
+                else:
+                    print('%-8s %10.1f %10d %10.1f %10.2f %10.0f %12.1f %8s' % (impl.name, startup[impl.name] * 1e3, statements, best * 1e3, rate, statements / best, rss, check))
+
+        mismatched = any(row[4] != 'ok' for name in rows for row in rows[name])
+    finally:
+        shutil.rmtree(workdir)
+
+    sys.exit(1 if mismatched else 0)
+
+if __name__ == '__main__':
+    main()
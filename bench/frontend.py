@@ -0,0 +1,107 @@
+import os
+import sys
+import subprocess
+import tempfile
+import time
+
+# Times the Python port's front end against the native one it loads from c++/build, on the
+# same generated programs. Both have to end up with a tree buildAST can walk, so besides the
+# bare ctypes call the native side is also timed with a pass over every node it returned,
+# and the speedup is against that.
+#
+#   python3 bench/frontend.py [--sizes=1000,10000,100000] [--repeat=3]
+
+Root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+Generator = os.path.join(Root, 'c++', 'build', 'generate.out')
+sys.path.insert(0, os.path.join(Root, 'python'))
+
+def usage(prog):
+    print('Usage: %s [--sizes=N,...] [--repeat=N]' % prog, file=sys.stderr)
+    sys.exit(1)
+
+def generate(statements, path):
+    # The Python port parses a single compound statement
+    program = subprocess.run([Generator, '--assignments=%d' % statements], check=True, capture_output=True).stdout
+
+    with open(path, 'wb') as outFile:
+        outFile.write(b'{\n' + program + b'}\n')
+
+def python_frontend(Compiler, path):
+    compiler = Compiler(path, native=False)
+    start = time.perf_counter()
+    compiler.scan()
+    compiler.compound_statement()
+    elapsed = time.perf_counter() - start
+    compiler.inFile.close()
+    return elapsed
+
+def native_frontend(frontend, lib, path):
+    start = time.perf_counter()
+
+    with open(path, 'rb') as inFile:
+        tree = frontend.Tree(lib, inFile.read())
+
+    parsed = time.perf_counter() - start
+
+    if tree.error != None:
+        raise RuntimeError(tree.error)
+
+    # Touch every node once, in place, the way buildAST would
+    nodes = tree.nodes
+    ops = 0
+
+    for i in range(tree.contents.nodeCount):
+        ops += nodes[i].op
+
+    elapsed = time.perf_counter() - start
+    tokens = tree.contents.tokenCount
+    tree.close()
+    return parsed, elapsed, tokens
+
+def main():
+    sizes = [1000, 10000, 100000]
+    repeat = 3
+
+    for arg in sys.argv[1:]:
+        name, _, value = arg.partition('=')
+
+        try:
+            if name == '--sizes':
+                sizes = [int(s) for s in value.split(',')]
+            elif name == '--repeat':
+                repeat = int(value)
+            else:
+                usage(sys.argv[0])
+        except ValueError:
+            usage(sys.argv[0])
+
+    if (repeat < 1) or (min(sizes) < 1):
+        usage(sys.argv[0])
+
+    subprocess.run(['make', '-C', os.path.join(Root, 'c++'), 'build/generate.out', 'build/libfrontend.so'], check=True, capture_output=True)
+
+    try:
+        from compiler import Compiler
+    except ImportError as e:
+        print('Python port unavailable: %s' % e, file=sys.stderr)
+        sys.exit(1)
+
+    import frontend
+    lib = frontend.load()
+
+    print('%10s %10s %12s %12s %12s %14s %10s' % ('stmts', 'tokens', 'python ms', 'parse ms', 'walked ms', 'parse tok/s', 'speedup'))
+    print('-' * 86)
+
+    with tempfile.TemporaryDirectory(prefix='frontend') as workdir:
+        for size in sizes:
+            path = os.path.join(workdir, 'program%d.c' % size)
+            generate(size, path)
+            python = min(python_frontend(Compiler, path) for _ in range(repeat))
+            runs = [native_frontend(frontend, lib, path) for _ in range(repeat)]
+            parse = min(r[0] for r in runs)
+            walked = min(r[1] for r in runs)
+            tokens = runs[0][2]
+            print('%10d %10d %12.1f %12.2f %12.2f %14.0f %9.1fx' % (size, tokens, python * 1e3, parse * 1e3, walked * 1e3, tokens / parse, python / walked))
+
+if __name__ == '__main__':
+    main()
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "compiler.hpp"
+#include <string>
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Instructions.h>
+using namespace std;
+using namespace llvm;
+
+// Arrays start on a vector boundary, a whole cache line once they fill one, so vectorized
+// loops over them never need a peeled prologue or split loads
+MaybeAlign array_alignment(unsigned length) {
+    if (length == 0) {
+        return MaybeAlign();
+    }
+
+    return Align((length * 4 >= 64) ? 64 : 32);
+}
+
+// The size in brackets after an array's name
+unsigned Compiler::array_length() {
+    lbracket();
+
+    if ((token.type != TokenType::T_IntLit) || (token.intValue <= 0)) {
+        cerr << "Array size must be a positive integer on line " << line << endl;
+        exit(1);
+    }
+
+    unsigned length = token.intValue;
+    scan();
+    rbracket();
+    return length;
+}
+
+Type* Compiler::symbol_type(string global_var, LLVMContext* context) {
+    Type* int_type = Type::getInt32Ty(*context);
+
+    if (pointers.count(global_var)) {
+        return int_type->getPointerTo();
+    }
+
+    auto found = lengths.find(global_var);
+    return (found == lengths.end()) ? int_type : ArrayType::get(int_type, found->second);
+}
+
+// An element of the array just named, A_Index to read it and A_LVIndex to assign to it
+ASTNode* Compiler::index(ASTNodeOp op, Value* array) {
+    lbracket();
+    ASTNode* at = binexpr(0);
+    rbracket();
+    return mknode(op, at, nullptr, array);
+}
+
+// What a variable's alloca or global holds
+Type* storage_type(Value* var) {
+    return isa<AllocaInst>(var) ? cast<AllocaInst>(var)->getAllocatedType() : cast<GlobalVariable>(var)->getValueType();
+}
+
+// Arrays are whole allocas or globals of known size, so an inbounds GEP from their start
+// tells LLVM the access is dereferenceable and can't alias any other array
+Value* Compiler::element(IRBuilder<>* builder, Value* array, Value* at) {
+    Value* offset = builder->CreateSExt(at, builder->getInt64Ty());
+    return builder->CreateInBoundsGEP(storage_type(array), array, {builder->getInt64(0), offset});
+}
\ No newline at end of file
@@ -2,18 +2,41 @@
 #include "astNodeOp.hpp"
 #include <llvm/IR/Value.h>
 #include <variant>
+#include <cstddef>
 using namespace std;
 using namespace llvm;
 
 typedef variant<int, Value*> ASTValue;
 
+// How many nodes have been allocated, are alive now and were alive at once, for --stats
+struct ASTCounters {
+    size_t allocated;
+    size_t live;
+    size_t peak;
+};
+
+inline ASTCounters astCounters = {0, 0, 0};
+
 struct ASTNode {
     ASTNodeOp op;
+    unsigned refs;      // Holders of a node shared by --dag, including the table, 0 for a node with one owner
     ASTNode* left;
     ASTNode* right;
     ASTValue value;
 
     ASTNode() : ASTNode(ASTNodeOp::A_Add, nullptr, nullptr, (int)0) {}
     ASTNode(ASTNodeOp op, ASTValue value) : ASTNode(op, nullptr, nullptr, value) {}
-    ASTNode(ASTNodeOp op, ASTNode* left, ASTNode* right, ASTValue value) : op(op), left(left), right(right), value(value) {}
+    ASTNode(ASTNodeOp op, ASTNode* left, ASTNode* right, ASTValue value) : op(op), refs(0), left(left), right(right), value(value) {
+        astCounters.allocated++;
+
+        if (++astCounters.live > astCounters.peak) {
+            astCounters.peak = astCounters.live;
+        }
+    }
+
+    ASTNode(const ASTNode&) = delete;
+
+    ~ASTNode() {
+        astCounters.live--;
+    }
 };
\ No newline at end of file
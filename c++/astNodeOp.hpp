@@ -4,5 +4,9 @@ enum ASTNodeOp {
     A_Add=1, A_Subtract, A_Multiply, A_Divide,
     A_Equal, A_NotEqual, A_LessThan, A_GreaterThan, A_LessEqual, A_GreaterEqual,
     A_IntLit,
-    A_LVIdent, A_Assign, A_Ident
+    A_LVIdent, A_Assign, A_Ident,
+    A_Index, A_LVIndex,
+    A_Call, A_Arg,
+    A_Addr, A_Deref, A_LVDeref,
+    A_Builtin
 };
\ No newline at end of file
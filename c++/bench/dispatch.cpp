@@ -0,0 +1,171 @@
+#include "../compiler.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+using namespace std;
+using namespace llvm;
+
+// Dispatch cost of switch against the equivalent if-else chain. Each program runs a bytecode-style
+// loop over pseudo-random opcodes, handling each in one of OPCODES cases, and is timed as the best
+// of RUNS runs with its output discarded. The code is long enough that branch predictors can't
+// learn it by heart, and at -O2 the chain may be turned into a switch anyway.
+
+const int STEPS = 20000000;
+const int CODE_LENGTH = 65536;
+const int RUNS = 5;
+const int OPCODES[] = {4, 16, 64, 256};
+const int OPT_LEVELS[] = {0, 2};
+
+// What opcode k does, something different for each so the cases can't be merged into a table
+string opcode_body(int k) {
+    string reg = "r[" + to_string(k % 8) + "]";
+
+    switch (k % 4) {
+        case 0:
+            return "acc = acc + " + to_string(k + 1) + ";";
+        case 1:
+            return "acc = acc * 3 - " + to_string(k) + ";";
+        case 2:
+            return "acc = acc / 2 + " + to_string(k) + ";";
+        default:
+            return reg + " = " + reg + " + acc;";
+    }
+}
+
+string dispatch_program(int opcodes, bool useSwitch) {
+    string src =
+        "int code[" + to_string(CODE_LENGTH) + "];\n"
+        "int r[8];\n"
+        "int i;\n"
+        "int pc;\n"
+        "int acc;\n"
+        "int seed;\n"
+        "int steps;\n"
+        "int op;\n"
+        "int v;\n"
+        "for (i = 0; i < 8; i = i + 1) {\n"
+        "    r[i] = 0;\n"
+        "}\n"
+        "seed = 1;\n"
+        "for (i = 0; i < " + to_string(CODE_LENGTH) + "; i = i + 1) {\n"
+        "    seed = seed * 1103515245 + 12345;\n"
+        "    v = seed / 65536;\n"
+        "    v = v - v / " + to_string(opcodes) + " * " + to_string(opcodes) + ";\n"
+        "    if (v < 0) {\n"
+        "        v = v + " + to_string(opcodes) + ";\n"
+        "    }\n"
+        "    code[i] = v;\n"
+        "}\n"
+        "acc = 1;\n"
+        "pc = 0;\n"
+        "for (steps = 0; steps < " + to_string(STEPS) + "; steps = steps + 1) {\n"
+        "    op = code[pc];\n";
+
+    if (useSwitch) {
+        src += "    switch (op) {\n";
+
+        for (int k = 0; k < opcodes; k++) {
+            src += "        case " + to_string(k) + ":\n            " + opcode_body(k) + "\n            break;\n";
+        }
+
+        src += "    }\n";
+    } else {
+        for (int k = 0; k < opcodes; k++) {
+            src += string(k ? " else " : "    ") + "if (op == " + to_string(k) + ") {\n        " + opcode_body(k) + "\n    }";
+        }
+
+        src += "\n";
+    }
+
+    src +=
+        "    pc = pc + 1;\n"
+        "    if (pc == " + to_string(CODE_LENGTH) + ") {\n"
+        "        pc = 0;\n"
+        "    }\n"
+        "}\n"
+        "print acc;\n"
+        "print r[0] + r[1] + r[2] + r[3] + r[4] + r[5] + r[6] + r[7];\n";
+    return src;
+}
+
+string program_output(string exe) {
+    FILE* pipe = popen(exe.c_str(), "r");
+    string out;
+    char buf[4096];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        out.append(buf, n);
+    }
+
+    pclose(pipe);
+    return out;
+}
+
+// Builds the program into an executable, returning its path
+string build(string dir, string name, string src, int optLevel) {
+    string path = dir + "/" + name + ".c";
+    ofstream(path) << src;
+
+    Options options;
+    options.output = dir + "/" + name + ".o";
+    options.executable = dir + "/" + name;
+    options.optLevel = optLevel;
+    Compiler compiler(path, options);
+    compiler.run();
+    return options.executable;
+}
+
+double best_ms(string exe) {
+    string command = exe + " > /dev/null";
+    double best = 1e30;
+
+    for (int i = 0; i < RUNS; i++) {
+        auto start = chrono::steady_clock::now();
+
+        if (system(command.c_str()) != 0) {
+            fprintf(stderr, "Could not run %s\n", exe.c_str());
+            exit(1);
+        }
+
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+
+    return best;
+}
+
+int main() {
+    SmallString<128> dir;
+    sys::fs::createUniqueDirectory("bench_dispatch", dir);
+
+    printf("%-8s %4s %12s %12s %10s\n", "opcodes", "opt", "switch ms", "if-else ms", "speedup");
+    printf("%s\n", string(50, '-').c_str());
+    bool mismatch = false;
+
+    for (int optLevel : OPT_LEVELS) {
+        for (int opcodes : OPCODES) {
+            string name = to_string(opcodes) + ".O" + to_string(optLevel);
+            string switchExe = build(dir.str().str(), name + ".switch", dispatch_program(opcodes, true), optLevel);
+            string chainExe = build(dir.str().str(), name + ".chain", dispatch_program(opcodes, false), optLevel);
+
+            if (program_output(switchExe) != program_output(chainExe)) {
+                printf("%-8d %4s %12s\n", opcodes, ("-O" + to_string(optLevel)).c_str(), "output differs");
+                mismatch = true;
+                continue;
+            }
+
+            double switchMs = best_ms(switchExe);
+            double chainMs = best_ms(chainExe);
+            printf("%-8d %4s %12.1f %12.1f %10.2f\n", opcodes, ("-O" + to_string(optLevel)).c_str(), switchMs, chainMs, chainMs / switchMs);
+        }
+    }
+
+    sys::fs::remove_directories(dir);
+    return mismatch ? 1 : 0;
+}
\ No newline at end of file
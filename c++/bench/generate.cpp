@@ -0,0 +1,64 @@
+#include "workload.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+using namespace std;
+
+// Writes a synthetic program to stdout, for feeding the compilers by hand
+
+void usage(char* prog) {
+    cerr << "Usage: " << prog << " [options]" << endl;
+    cerr << "  --declarations=N              Declare N variables (default 100)" << endl;
+    cerr << "  --assignments=N               Follow them with N assignments (default 10000)" << endl;
+    cerr << "  --depth=N                     Binary operators per expression (default 4)" << endl;
+    cerr << "  --ident-length=MIN:MAX        Identifier lengths, uniform in between (default 1:8)" << endl;
+    cerr << "  --skew=S                      Zipf exponent of variable use (default 0, uniform)" << endl;
+    cerr << "  --print-every=N               Print after every N assignments, 0 for never (default 100)" << endl;
+    cerr << "  --seed=N                      Random seed (default 1)" << endl;
+    exit(1);
+}
+
+// Value of a --flag=N option
+unsigned long number_arg(char* prog, string value) {
+    if ((value.empty()) || (value.find_first_not_of("0123456789") != string::npos)) {
+        usage(prog);
+    }
+
+    return stoul(value);
+}
+
+int main(int argc, char* argv[]) {
+    Workload w(100, 10000, 4);
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        string value = arg.substr(arg.find('=') + 1);
+
+        if (arg.rfind("--declarations=", 0) == 0) {
+            w.declarations = number_arg(argv[0], value);
+        } else if (arg.rfind("--assignments=", 0) == 0) {
+            w.assignments = number_arg(argv[0], value);
+        } else if (arg.rfind("--depth=", 0) == 0) {
+            w.depth = number_arg(argv[0], value);
+        } else if ((arg.rfind("--ident-length=", 0) == 0) && (value.find(':') != string::npos)) {
+            w.minIdent = number_arg(argv[0], value.substr(0, value.find(':')));
+            w.maxIdent = number_arg(argv[0], value.substr(value.find(':') + 1));
+        } else if (arg.rfind("--skew=", 0) == 0) {
+            w.skew = atof(value.c_str());
+        } else if (arg.rfind("--print-every=", 0) == 0) {
+            w.printEvery = number_arg(argv[0], value);
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            w.seed = number_arg(argv[0], value);
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    // Identifiers longer than the lexer's limit would be rejected
+    if ((w.minIdent < 1) || (w.maxIdent < w.minIdent) || (w.maxIdent > 500)) {
+        usage(argv[0]);
+    }
+
+    cout << generate(w);
+    return 0;
+}
\ No newline at end of file
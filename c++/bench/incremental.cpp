@@ -0,0 +1,80 @@
+#include "../compiler.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+using namespace std;
+using namespace llvm;
+
+// Recompile latency after a single-line edit, against a full front-end build
+
+const int EDITS = 21;
+
+string program(int statements, int literal) {
+    string src = "int x;\nint y;\n";
+
+    for (int i = 0; i < statements; i += 2) {
+        int value = (i == statements / 2) ? literal : i % 100;
+        src += "x = y + " + to_string(value) + " * 3;\nprint x;\n";
+    }
+
+    return src;
+}
+
+double elapsed(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+double median(vector<double> times) {
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main() {
+    SmallString<128> path;
+    sys::fs::createTemporaryFile("bench_incremental", "c", path);
+    printf("%12s %16s %16s %16s\n", "statements", "full build us", "edit line us", "insert line us");
+
+    for (int statements : {1000, 10000, 100000, 1000000}) {
+        string src = program(statements, 0);
+        ofstream(path.c_str()) << src;
+
+        Options options;
+        options.incremental = true;
+        Compiler compiler(path.c_str(), options);
+        auto start = chrono::steady_clock::now();
+        compiler.build();
+        double full = elapsed(start);
+
+        // Change one literal in the middle of the program, keeping the line count
+        vector<double> edits;
+
+        for (int i = 1; i <= EDITS; i++) {
+            string edited = program(statements, i % 10);
+            start = chrono::steady_clock::now();
+            compiler.update(move(edited));
+            edits.push_back(elapsed(start));
+        }
+
+        // Insert and remove a whole line in the middle
+        vector<double> inserts;
+        size_t middle = src.find('\n', src.size() / 2) + 1;
+        string inserted = src.substr(0, middle) + "print y;\n" + src.substr(middle);
+
+        for (int i = 1; i <= EDITS; i++) {
+            string edited = (i % 2) ? inserted : src;
+            start = chrono::steady_clock::now();
+            compiler.update(move(edited));
+            inserts.push_back(elapsed(start));
+        }
+
+        printf("%12d %16.0f %16.1f %16.1f\n", statements, full, median(edits), median(inserts));
+    }
+
+    sys::fs::remove(path);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "../compiler.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+#include "../run.h"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+using namespace std;
+using namespace llvm;
+
+// Launch-to-exit time of short programs, built against libc as usual, statically against it,
+// and with -ffreestanding-runtime. Each executable is started LAUNCHES times with stdout on
+// /dev/null and the median wall time of a run is reported. For comparison, the program is also
+// built with -shared and its run() called that many times in this process.
+
+const int LAUNCHES = 501;
+
+struct Build {
+    const char* name;
+    bool staticLink;
+    bool freestanding;
+};
+
+const Build builds[] = {
+    {"libc", false, false},
+    {"static", true, false},
+    {"freestanding", false, true},
+};
+
+string program_output(string exe) {
+    FILE* pipe = popen(exe.c_str(), "r");
+    string out;
+    char buf[4096];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        out.append(buf, n);
+    }
+
+    pclose(pipe);
+    return out;
+}
+
+double launch_us(string exe, int devnull) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, devnull, STDOUT_FILENO);
+    char* argv[] = {(char*)exe.c_str(), nullptr};
+    char* envp[] = {nullptr};
+    vector<double> times;
+
+    for (int i = 0; i < LAUNCHES; i++) {
+        pid_t pid;
+        int status;
+        auto start = chrono::steady_clock::now();
+
+        if ((posix_spawn(&pid, exe.c_str(), &actions, nullptr, argv, envp) != 0) || (waitpid(pid, &status, 0) != pid)) {
+            fprintf(stderr, "Could not run %s\n", exe.c_str());
+            exit(1);
+        }
+
+        times.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// Collects what a run prints, or drops it when timing
+struct Capture {
+    RunContext base;
+    string* out;
+};
+
+void capture(RunContext* ctx, int value) {
+    string* out = ((Capture*)ctx)->out;
+
+    if (out) {
+        *out += to_string(value) + "\n";
+    }
+}
+
+double run_us(string lib, string* out) {
+    void* handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+    if (!handle) {
+        fprintf(stderr, "%s\n", dlerror());
+        exit(1);
+    }
+
+    int (*run_fn)(void*) = (int (*)(void*))dlsym(handle, "run");
+    Capture ctx = {{capture}, out};
+    run_fn(&ctx);
+    ctx.out = nullptr;
+    vector<double> times;
+
+    for (int i = 0; i < LAUNCHES; i++) {
+        auto start = chrono::steady_clock::now();
+        run_fn(&ctx);
+        times.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+
+    dlclose(handle);
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+    string suite = (argc > 1) ? argv[1] : "../input";
+    vector<string> programs;
+    error_code EC;
+
+    for (sys::fs::directory_iterator it(suite, EC), end; (it != end) && (!EC); it.increment(EC)) {
+        if (sys::fs::is_regular_file(it->path())) {
+            programs.push_back(it->path());
+        }
+    }
+
+    if ((EC) || (programs.empty())) {
+        fprintf(stderr, "No programs found in %s\n", suite.c_str());
+        return 1;
+    }
+
+    std::sort(programs.begin(), programs.end());
+    SmallString<128> dir;
+    sys::fs::createUniqueDirectory("bench_launch", dir);
+    int devnull = open("/dev/null", O_WRONLY);
+
+    printf("%-12s %10s %10s %16s %10s %12s\n", "program", "libc us", "static us", "freestanding us", "speedup", "run() us");
+    printf("%s\n", string(75, '-').c_str());
+    bool mismatch = false;
+
+    for (string path : programs) {
+        string name = sys::path::filename(path).str();
+        vector<string> exes;
+
+        for (const Build& build : builds) {
+            Options options;
+            options.output = string(dir) + "/" + name + ".o";
+            options.executable = string(dir) + "/" + name + "." + build.name;
+            options.staticLink = build.staticLink;
+            options.freestanding = build.freestanding;
+            Compiler compiler(path, options);
+            compiler.run();
+            exes.push_back(options.executable);
+        }
+
+        Options options;
+        options.output = string(dir) + "/" + name + ".o";
+        options.executable = string(dir) + "/" + name + ".so";
+        options.sharedObject = true;
+        Compiler(path, options).run();
+
+        string expected = program_output(exes[0]);
+        string printed;
+        double inProcess = run_us(options.executable, &printed);
+
+        if ((program_output(exes[1]) != expected) || (program_output(exes[2]) != expected) || (printed != expected)) {
+            printf("%-12s %10s\n", name.c_str(), "output differs");
+            mismatch = true;
+            continue;
+        }
+
+        double times[3];
+
+        for (int i = 0; i < 3; i++) {
+            times[i] = launch_us(exes[i], devnull);
+        }
+
+        printf("%-12s %10.1f %10.1f %16.1f %10.2f %12.2f\n", name.c_str(), times[0], times[1], times[2], times[0] / times[2], inProcess);
+    }
+
+    close(devnull);
+    sys::fs::remove_directories(dir);
+    return mismatch ? 1 : 0;
+}
\ No newline at end of file
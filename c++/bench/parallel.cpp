@@ -0,0 +1,144 @@
+#include "../compiler.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+using namespace std;
+using namespace llvm;
+
+// How a parallel for reduction scales with the number of workers. The kernel sums and takes the
+// largest of a division-heavy expression over an array, REPS times, so it's bound by the cores
+// rather than memory. It's built at -O2 as a plain for loop and as a parallel for, and the parallel
+// one is run with $PARALLEL_WORKERS at each power of two up to the number of cores. Times are the
+// best of RUNS runs, with the output checked against the sequential build.
+
+const int LENGTH = 1 << 20;
+const int REPS = 20;
+const int RUNS = 3;
+
+string reduction_program(bool parallel) {
+    string loop = parallel ? "    parallel reduction(+: sum) reduction(max: top) for (i = 0; i < " : "    for (i = 0; i < ";
+
+    return
+        "int a[" + to_string(LENGTH) + "];\n"
+        "int i;\n"
+        "int r;\n"
+        "int q;\n"
+        "int sum;\n"
+        "int top;\n"
+        "for (i = 0; i < " + to_string(LENGTH) + "; i = i + 1) {\n"
+        "    a[i] = i * 7919 - i / 13 * 101;\n"
+        "}\n"
+        "sum = 0;\n"
+        "top = 0 - 2147483647;\n"
+        "for (r = 1; r < " + to_string(REPS + 1) + "; r = r + 1) {\n"
+        "    q = r + 7;\n" +
+        loop + to_string(LENGTH) + "; i = i + 1) {\n"
+        "        int v;\n"
+        "        v = a[i] / r + a[i] / q * 3 - a[i] / 11;\n"
+        "        sum = sum + v;\n"
+        "        if (v > top) {\n"
+        "            top = v;\n"
+        "        }\n"
+        "    }\n"
+        "}\n"
+        "print sum;\n"
+        "print top;\n";
+}
+
+string program_output(string exe) {
+    FILE* pipe = popen(exe.c_str(), "r");
+    string out;
+    char buf[4096];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        out.append(buf, n);
+    }
+
+    pclose(pipe);
+    return out;
+}
+
+// Builds the program into an executable, returning its path
+string build(string dir, string name, string src) {
+    string path = dir + "/" + name + ".c";
+    ofstream(path) << src;
+
+    Options options;
+    options.output = dir + "/" + name + ".o";
+    options.executable = dir + "/" + name;
+    options.optLevel = 2;
+    Compiler compiler(path, options);
+    compiler.run();
+    return options.executable;
+}
+
+double best_ms(string command) {
+    command += " > /dev/null";
+    double best = 1e30;
+
+    for (int i = 0; i < RUNS; i++) {
+        auto start = chrono::steady_clock::now();
+
+        if (system(command.c_str()) != 0) {
+            fprintf(stderr, "Could not run %s\n", command.c_str());
+            exit(1);
+        }
+
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+
+    return best;
+}
+
+int main() {
+    SmallString<128> dir;
+    sys::fs::createUniqueDirectory("bench_parallel", dir);
+    string sequential = build(dir.str().str(), "sequential", reduction_program(false));
+    string parallel = build(dir.str().str(), "parallel", reduction_program(true));
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    vector<unsigned> workers;
+
+    for (unsigned count = 1; count < cores; count *= 2) {
+        workers.push_back(count);
+    }
+
+    workers.push_back(cores);
+
+    string expected = program_output(sequential);
+    double sequentialMs = best_ms(sequential);
+    bool mismatch = false;
+
+    printf("cores: %u, sequential: %.1f ms\n\n", cores, sequentialMs);
+    printf("%-8s %10s %12s %10s\n", "workers", "ms", "vs 1 worker", "vs for");
+    printf("%s\n", string(43, '-').c_str());
+    double oneMs = 0;
+
+    for (unsigned count : workers) {
+        string command = "PARALLEL_WORKERS=" + to_string(count) + " " + parallel;
+
+        if (program_output(command) != expected) {
+            printf("%-8u %10s\n", count, "output differs");
+            mismatch = true;
+            continue;
+        }
+
+        double ms = best_ms(command);
+
+        if (count == 1) {
+            oneMs = ms;
+        }
+
+        printf("%-8u %10.1f %12.2f %10.2f\n", count, ms, oneMs / ms, sequentialMs / ms);
+    }
+
+    sys::fs::remove_directories(dir);
+    return mismatch ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "../compiler.hpp"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+using namespace std;
+using namespace llvm;
+
+// Run time of the code we generate at -O2 against gcc -O2 on the same program. Each program in
+// bench/quality is compiled by us and, as C, by the system compiler; both objects have
+// main renamed and are linked to a driver that calls it in a loop with stdout discarded.
+// Both sides target the host CPU, ours through the default -march=native.
+
+const char* driver =
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <time.h>\n"
+    "int kernel(void);\n"
+    "static double now(void) {\n"
+    "    struct timespec ts;\n"
+    "    clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+    "    return ts.tv_sec + ts.tv_nsec * 1e-9;\n"
+    "}\n"
+    "int main(int argc, char** argv) {\n"
+    "    if (argc < 2) {\n"
+    "        return kernel();\n"
+    "    }\n"
+    "    freopen(\"/dev/null\", \"w\", stdout);\n"
+    "    long reps = 1;\n"
+    "    double start = now();\n"
+    "    for (;;) {\n"
+    "        for (long i = 0; i < reps; i++) kernel();\n"
+    "        if (now() - start > 0.05) break;\n"
+    "        reps *= 2;\n"
+    "        start = now();\n"
+    "    }\n"
+    "    double best = 1e30;\n"
+    "    for (int batch = 0; batch < 5; batch++) {\n"
+    "        start = now();\n"
+    "        for (long i = 0; i < reps; i++) kernel();\n"
+    "        double t = (now() - start) / reps;\n"
+    "        if (t < best) best = t;\n"
+    "    }\n"
+    "    fprintf(stderr, \"%.1f\\n\", best * 1e9);\n"
+    "    return 0;\n"
+    "}\n";
+
+string command_output(string cmd) {
+    FILE* pipe = popen(cmd.c_str(), "r");
+    string out;
+    char buf[4096];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        out.append(buf, n);
+    }
+
+    if (pclose(pipe) != 0) {
+        fprintf(stderr, "Command failed: %s\n", cmd.c_str());
+        exit(1);
+    }
+
+    return out;
+}
+
+// The language is a subset of C apart from print, which becomes printf, and top-level
+// statements, which go in main. Function definitions start with "int name(" and end with
+// a "}" line, both unindented, and are moved out ahead of main.
+string as_c(string src) {
+    stringstream in(src);
+    string line, functions = "#include <stdio.h>\n", out = "int main(void) {\n";
+    bool inFunction = false;
+
+    while (getline(in, line)) {
+        size_t at = line.find("print ");
+
+        if ((at != string::npos) && (line.find_first_not_of(" \t") == at)) {
+            size_t semi = line.rfind(';');
+            line = line.substr(0, at) + "printf(\"%d\\n\", " + line.substr(at + 6, semi - at - 6) + ");";
+        }
+
+        if ((line.rfind("int ", 0) == 0) && (line.find('(') != string::npos)) {
+            inFunction = true;
+        }
+
+        if (inFunction) {
+            functions += line + "\n";
+            inFunction = (line != "}");
+        } else {
+            out += "    " + line + "\n";
+        }
+    }
+
+    return functions + out + "    return 0;\n}\n";
+}
+
+// Links an object's main as kernel() into the driver, returning the executable
+string link(string dir, string obj, string name) {
+    string renamed = dir + "/" + name + ".kernel.o";
+    string exe = dir + "/" + name;
+    command_output("objcopy --redefine-sym main=kernel " + obj + " " + renamed);
+    command_output("cc -O2 -no-pie -o " + exe + " " + dir + "/driver.c " + renamed);
+    return exe;
+}
+
+int main(int argc, char* argv[]) {
+    string suite = (argc > 1) ? argv[1] : "bench/quality";
+    vector<string> programs;
+    error_code EC;
+
+    for (sys::fs::directory_iterator it(suite, EC), end; (it != end) && (!EC); it.increment(EC)) {
+        if (sys::path::extension(it->path()) == ".c") {
+            programs.push_back(it->path());
+        }
+    }
+
+    if ((EC) || (programs.empty())) {
+        fprintf(stderr, "No programs found in %s\n", suite.c_str());
+        return 1;
+    }
+
+    std::sort(programs.begin(), programs.end());
+    SmallString<128> dir;
+    sys::fs::createUniqueDirectory("bench_quality", dir);
+    ofstream(string(dir) + "/driver.c") << driver;
+
+    printf("%-16s %14s %14s %10s\n", "program", "ours ns", "gcc -O2 ns", "ratio");
+    printf("%s\n", string(57, '-').c_str());
+    bool mismatch = false;
+
+    for (string path : programs) {
+        string name = sys::path::stem(path).str();
+        string ours = string(dir) + "/" + name + ".ours.o";
+        string ref = string(dir) + "/" + name + ".ref.c";
+
+        Options options;
+        options.output = ours;
+        options.optLevel = 2;
+        Compiler compiler(path, options);
+        compiler.run();
+
+        // Signed overflow wraps in the code we generate, so it has to in the reference too
+        ofstream(ref) << as_c(readfile(path));
+        command_output("cc -O2 -march=native -fwrapv -c -o " + string(dir) + "/" + name + ".ref.o " + ref);
+
+        string oursExe = link(dir.str().str(), ours, name + ".ours");
+        string refExe = link(dir.str().str(), string(dir) + "/" + name + ".ref.o", name + ".ref");
+
+        if (command_output(oursExe) != command_output(refExe)) {
+            printf("%-16s %14s\n", name.c_str(), "output differs");
+            mismatch = true;
+            continue;
+        }
+
+        double oursNs = atof(command_output(oursExe + " time 2>&1").c_str());
+        double refNs = atof(command_output(refExe + " time 2>&1").c_str());
+        printf("%-16s %14.1f %14.1f %10.2f\n", name.c_str(), oursNs, refNs, oursNs / refNs);
+    }
+
+    sys::fs::remove_directories(dir);
+    return mismatch ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+int a[4096];
+int b[4096];
+int i;
+int s;
+for (i = 0; i < 4096; i = i + 1) {
+    a[i] = i * 3;
+    b[i] = 4096 - i;
+}
+for (i = 0; i < 4096; i = i + 1) {
+    a[i] = a[i] + b[i] * 2;
+}
+s = 0;
+for (i = 0; i < 4096; i = i + 1) {
+    s = s + a[i] / 3;
+}
+print s;
+print a[100];
\ No newline at end of file
@@ -0,0 +1,16 @@
+int f[64];
+int i;
+int n;
+int s;
+s = 0;
+for (n = 1; n < 2000; n = n + 1) {
+    f[0] = n;
+    f[1] = n * 7 + 1;
+    for (i = 2; i < 64; i = i + 1) {
+        f[i] = f[i - 1] + f[i - 2];
+        f[i] = f[i] - f[i] / 1000003 * 1000003;
+    }
+    s = s + f[63] - s / 3;
+}
+print s;
+print f[40];
\ No newline at end of file
@@ -0,0 +1,31 @@
+int key[4096];
+int bucket[256];
+int i;
+int r;
+int x;
+int h;
+x = 12345;
+for (i = 0; i < 4096; i = i + 1) {
+    x = x * 1103515245 + 12345;
+    key[i] = x;
+}
+for (i = 0; i < 256; i = i + 1) {
+    bucket[i] = 0;
+}
+for (r = 0; r < 8; r = r + 1) {
+    for (i = 0; i < 4096; i = i + 1) {
+        h = key[i] * 31 + r;
+        h = h - h / 65521 * 65521;
+        if (h < 0) {
+            h = 0 - h;
+        }
+        h = h - h / 256 * 256;
+        bucket[h] = bucket[h] + 1;
+    }
+}
+h = 0;
+for (i = 0; i < 256; i = i + 1) {
+    h = h * 31 + bucket[i];
+}
+print h;
+print bucket[7];
\ No newline at end of file
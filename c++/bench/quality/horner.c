@@ -0,0 +1,22 @@
+int c[16];
+int x[2048];
+int i;
+int j;
+int p;
+int s;
+for (j = 0; j < 16; j = j + 1) {
+    c[j] = j * 37 - 200;
+}
+for (i = 0; i < 2048; i = i + 1) {
+    x[i] = i - 1024;
+}
+s = 0;
+for (i = 0; i < 2048; i = i + 1) {
+    p = c[15];
+    for (j = 14; j >= 0; j = j - 1) {
+        p = p * x[i] + c[j];
+    }
+    s = s + p / 1024;
+}
+print s;
+print p;
\ No newline at end of file
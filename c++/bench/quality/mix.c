@@ -0,0 +1,24 @@
+int scale(int v, int k) {
+    return v * k - v / 7;
+}
+int a[1024];
+int i;
+int r;
+int s;
+int t;
+for (i = 0; i < 1024; i = i + 1) {
+    a[i] = i * 40503 - i / 3 * 17;
+}
+s = 0;
+t = 1;
+for (r = 0; r < 16; r = r + 1) {
+    for (i = 0; i < 1024; i = i + 1) {
+        t = scale(a[i], r + 3) + t / 3;
+        s = s + t - s / 5;
+        if (t > s) {
+            a[i] = a[i] + 1;
+        }
+    }
+}
+print s;
+print t;
\ No newline at end of file
@@ -0,0 +1,20 @@
+int sum(int n, int acc) {
+    while (n > 0) {
+        return sum(n - 1, acc + n * n / 3);
+    }
+    return acc;
+}
+int gcd(int a, int b) {
+    while (b != 0) {
+        return gcd(b, a - a / b * b);
+    }
+    return a;
+}
+int i;
+int g;
+g = 0;
+for (i = 1; i < 2000; i = i + 1) {
+    g = g + gcd(i * 7919, 104729 - i);
+}
+print g;
+print sum(100000, 0);
\ No newline at end of file
@@ -0,0 +1,17 @@
+int i;
+int j;
+int s;
+int t;
+s = 0;
+t = 0;
+#pragma clang loop vectorize(enable) interleave_count(4)
+for (i = 0; i < 100000; i = i + 1) {
+    s = s + i * 3 - i / 5;
+}
+for (j = 0; j < 64; j = j + 1) {
+    for (i = 0; i < 1024; i = i + 1) {
+        t = t + i * i - j * j;
+    }
+}
+print s;
+print t;
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "../compiler.hpp"
+#include "workload.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+using namespace std;
+using namespace llvm;
+
+// Throughput of each compiler phase on generated programs, in the manner of Google Benchmark:
+// every case is repeated until it has run for at least MIN_TIME, then the mean is reported
+
+const double MIN_TIME = 0.5;
+
+struct Case {
+    string name;
+    Workload workload;
+    bool emit;              // Also generate an object file, which dominates the time
+};
+
+struct Totals {
+    double seconds[Ph_Count];
+    double wall;
+    int iterations;
+
+    Totals() : seconds(), wall(0), iterations(0) {}
+};
+
+Totals measure(const Case& c, const char* path, const char* object) {
+    Totals totals;
+
+    while ((totals.iterations == 0) || (totals.wall < MIN_TIME)) {
+        Options options;
+
+        // Monolithic code generation is quadratic in this target, so emit in chunks as --threads does
+        if (c.emit) {
+            options.chunkSize = DEFAULT_CHUNK_SIZE;
+        }
+
+        auto start = chrono::steady_clock::now();
+        Compiler compiler(path, options);
+        compiler.phases().enable();
+        compiler.build();
+
+        if (c.emit) {
+            compiler.emit(object);
+        }
+
+        totals.wall += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        totals.iterations++;
+
+        for (int i = 0; i < Ph_Count; i++) {
+            totals.seconds[i] += compiler.phases().elapsed((Phase)i);
+        }
+    }
+
+    return totals;
+}
+
+void row(string name, double seconds, int iterations, size_t bytes, size_t statements) {
+    double mean = seconds / iterations;
+    printf("%-44s %12.3f %10d %10.1f %14.0f\n", name.c_str(), mean * 1e3, iterations, bytes / mean / 1e6, statements / mean);
+}
+
+Workload shaped(size_t declarations, size_t assignments, int depth, int minIdent, int maxIdent, double skew) {
+    Workload w(declarations, assignments, depth);
+    w.minIdent = minIdent;
+    w.maxIdent = maxIdent;
+    w.skew = skew;
+    return w;
+}
+
+int main(int argc, char* argv[]) {
+    // Optional substring of the case names to run
+    const char* filter = (argc > 1) ? argv[1] : "";
+
+    vector<Case> cases = {
+        {"stmts:10k/depth:4", Workload(100, 10000, 4), false},
+        {"stmts:100k/depth:4", Workload(100, 100000, 4), false},
+        {"stmts:1M/depth:4", Workload(100, 1000000, 4), false},
+        {"stmts:100k/depth:1", Workload(100, 100000, 1), false},
+        {"stmts:100k/depth:16", Workload(100, 100000, 16), false},
+        {"stmts:100k/vars:10k", Workload(10000, 100000, 4), false},
+        {"stmts:100k/ident:32-64", shaped(100, 100000, 4, 32, 64, 0), false},
+        {"stmts:100k/zipf:1.2", shaped(1000, 100000, 4, 1, 8, 1.2), false},
+        {"stmts:1k/depth:4/emit", Workload(100, 1000, 4), true},
+        {"stmts:10k/depth:4/emit", Workload(100, 10000, 4), true},
+    };
+
+    SmallString<128> path, object;
+    sys::fs::createTemporaryFile("bench_throughput", "c", path);
+    sys::fs::createTemporaryFile("bench_throughput", "o", object);
+
+    printf("%-44s %12s %10s %10s %14s\n", "Benchmark", "Time ms", "Iterations", "MB/s", "Statements/s");
+    printf("%s\n", string(94, '-').c_str());
+
+    for (const Case& c : cases) {
+        if (!strstr(c.name.c_str(), filter)) {
+            continue;
+        }
+
+        string src = generate(c.workload);
+        ofstream(path.c_str()) << src;
+
+        Totals totals = measure(c, path.c_str(), object.c_str());
+        size_t statements = statement_count(c.workload);
+
+        row("BM_Lex/" + c.name, totals.seconds[Ph_Lex], totals.iterations, src.size(), statements);
+        row("BM_Parse/" + c.name, totals.seconds[Ph_Parse], totals.iterations, src.size(), statements);
+        row("BM_IRGen/" + c.name, totals.seconds[Ph_IRGen], totals.iterations, src.size(), statements);
+
+        if (c.emit) {
+            row("BM_Emit/" + c.name, totals.seconds[Ph_CodeGen], totals.iterations, src.size(), statements);
+        }
+
+        row("BM_Total/" + c.name, totals.wall, totals.iterations, src.size(), statements);
+    }
+
+    sys::fs::remove(path);
+    sys::fs::remove(object);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+#include "../keywords.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// Shape of a synthetic program for the benchmarks
+struct Workload {
+    size_t declarations;    // Variables declared, and initialised, up front
+    size_t assignments;     // Assignment statements after the declarations
+    int depth;              // Binary operators in each assigned expression
+    int minIdent;           // Shortest identifier
+    int maxIdent;           // Longest identifier, lengths are uniform in between
+    double skew;            // Zipf exponent of variable use, 0 picks every variable equally often
+    size_t printEvery;      // Print the assigned variable after this many assignments, 0 for never
+    uint64_t seed;
+
+    Workload(size_t declarations, size_t assignments, int depth) : declarations(declarations), assignments(assignments), depth(depth), minIdent(1), maxIdent(8), skew(0), printEvery(100), seed(1) {}
+};
+
+// Small deterministic generator, so every implementation of the compiler sees the same program
+struct WorkloadRandom {
+    uint64_t state;
+
+    WorkloadRandom(uint64_t seed) : state(seed * 2 + 1) {}
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    size_t below(size_t n) {
+        return next() % n;
+    }
+
+    double unit() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+inline string workload_name(size_t index, size_t length, WorkloadRandom& random) {
+    const char* letters = "abcdefghijklmnopqrstuvwxyz";
+    const char* fill = "abcdefghijklmnopqrstuvwxyz0123456789";
+    string name;
+
+    // The index in base 26 keeps names unique, an underscore separates it from the padding
+    do {
+        name += letters[index % 26];
+        index /= 26;
+    } while (index);
+
+    if ((keyword_type(name) != T_EOF) || (name.size() < length)) {
+        name += '_';
+    }
+
+    while (name.size() < length) {
+        name += fill[random.below(36)];
+    }
+
+    return name;
+}
+
+inline string generate(const Workload& w) {
+    WorkloadRandom random(w.seed);
+    vector<string> names;
+    string src;
+
+    for (size_t i = 0; i < max(w.declarations, (size_t)1); i++) {
+        size_t length = w.minIdent + random.below(w.maxIdent - w.minIdent + 1);
+        names.push_back(workload_name(i, length, random));
+        src += "int " + names.back() + ";\n";
+    }
+
+    // Uninitialised variables would make the output depend on the implementation
+    for (size_t i = 0; i < names.size(); i++) {
+        src += names[i] + " = " + to_string(1 + random.below(99)) + ";\n";
+    }
+
+    // Cumulative weights of each variable being picked
+    vector<double> weights;
+    double total = 0;
+
+    for (size_t i = 0; i < names.size(); i++) {
+        total += (w.skew > 0) ? 1.0 / pow(i + 1, w.skew) : 1.0;
+        weights.push_back(total);
+    }
+
+    auto pick = [&]() -> const string& {
+        double r = random.unit() * total;
+        size_t i = lower_bound(weights.begin(), weights.end(), r) - weights.begin();
+        return names[min(i, names.size() - 1)];
+    };
+
+    const char* ops[] = {" + ", " - ", " * ", " / "};
+
+    for (size_t i = 0; i < w.assignments; i++) {
+        const string& target = pick();
+        src += target + " = " + pick();
+
+        for (int d = 0; d < w.depth; d++) {
+            int op = random.below(4);
+            src += ops[op];
+
+            // Only divide by literals, which are never zero
+            if ((op == 3) || (random.below(2))) {
+                src += to_string(1 + random.below(99));
+            } else {
+                src += pick();
+            }
+        }
+
+        src += ";\n";
+
+        if ((w.printEvery) && ((i + 1) % w.printEvery == 0)) {
+            src += "print " + target + ";\n";
+        }
+    }
+
+    return src;
+}
+
+// Statements in a generated program
+inline size_t statement_count(const Workload& w) {
+    size_t decls = max(w.declarations, (size_t)1);
+    return decls * 2 + w.assignments + (w.printEvery ? w.assignments / w.printEvery : 0);
+}
\ No newline at end of file
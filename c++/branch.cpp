@@ -0,0 +1,54 @@
+#include "compiler.hpp"
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/MDBuilder.h>
+using namespace std;
+using namespace llvm;
+
+// The same odds __builtin_expect gives a branch
+const uint32_t LIKELY_WEIGHT = 2000;
+const uint32_t UNLIKELY_WEIGHT = 1;
+
+// if (cond) stmt [else stmt]. A cond that is likely(), unlikely() or __builtin_expect with a constant
+// weights the branch itself, so the hint holds even without -O to lower llvm.expect
+void Compiler::if_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    match(T_If, "if");
+    lparen();
+    ASTNode* cond = binexpr(0);
+    rparen();
+    TokenType expect = expected_branch(cond);
+
+    BasicBlock* then_bb = new_block("if.then", builder->GetInsertBlock());
+    BasicBlock* end_bb = new_block("if.end", then_bb);
+
+    timer.enter(Ph_IRGen);
+    Value* test = builder->CreateIsNotNull(buildAST(cond, builder, context));
+    BranchInst* branch = builder->CreateCondBr(test, then_bb, end_bb);
+    timer.leave();
+    release(cond);
+
+    // Block placement lays the likely side out as the fall-through
+    if (expect == TokenType::T_Likely) {
+        branch->setMetadata(LLVMContext::MD_prof, MDBuilder(*context).createBranchWeights(LIKELY_WEIGHT, UNLIKELY_WEIGHT));
+    } else if (expect == TokenType::T_Unlikely) {
+        branch->setMetadata(LLVMContext::MD_prof, MDBuilder(*context).createBranchWeights(UNLIKELY_WEIGHT, LIKELY_WEIGHT));
+    }
+
+    // The branches may add blocks of their own, which end up before the next one
+    builder->SetInsertPoint(then_bb);
+    single_statement(builder, printf_type, printf_fn, context);
+
+    if (token.type == TokenType::T_Else) {
+        scan();
+        BasicBlock* else_bb = new_block("if.else", builder->GetInsertBlock());
+        branch->setSuccessor(1, else_bb);
+        builder->CreateBr(end_bb);
+        builder->SetInsertPoint(else_bb);
+        single_statement(builder, printf_type, printf_fn, context);
+    }
+
+    builder->CreateBr(end_bb);
+    builder->SetInsertPoint(end_bb);
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/ADT/APInt.h>
+using namespace std;
+using namespace llvm;
+
+// __builtin_ functions become the LLVM intrinsic for the same thing, or with constant
+// arguments the constant it would compute
+
+enum Builtin {
+    B_Expect, B_Popcount, B_Clz, B_Ctz, B_Prefetch, B_Assume, B_Unreachable
+};
+
+struct BuiltinInfo {
+    const char* name;
+    Builtin id;
+    size_t minArgs;
+    size_t maxArgs;
+    bool value;         // Has a value, rather than only being a statement
+};
+
+const BuiltinInfo builtins[] = {
+    {"__builtin_expect", B_Expect, 2, 2, true},
+    {"__builtin_popcount", B_Popcount, 1, 1, true},
+    {"__builtin_clz", B_Clz, 1, 1, true},
+    {"__builtin_ctz", B_Ctz, 1, 1, true},
+    {"__builtin_prefetch", B_Prefetch, 1, 3, false},
+    {"__builtin_assume", B_Assume, 1, 1, false},
+    {"__builtin_unreachable", B_Unreachable, 0, 0, false},
+};
+
+const BuiltinInfo* find_builtin(string name) {
+    for (const BuiltinInfo& info : builtins) {
+        if (name == info.name) {
+            return &info;
+        }
+    }
+
+    return nullptr;
+}
+
+bool is_builtin(string name) {
+    return find_builtin(name) != nullptr;
+}
+
+// name(a, b) once the name is read, only the builtins with a value can be part of an expression
+ASTNode* Compiler::builtin(string name, bool statement) {
+    const BuiltinInfo* info = find_builtin(name);
+    size_t count;
+    ASTNode* args = arguments(&count);
+
+    if ((count < info->minArgs) || (count > info->maxArgs)) {
+        cerr << name << " takes " << info->minArgs << ((info->maxArgs > info->minArgs) ? " to " + to_string(info->maxArgs) : "") << " arguments, " << count << " given on line " << line << endl;
+        exit(1);
+    }
+
+    if ((!statement) && (!info->value)) {
+        cerr << name << " has no value on line " << line << endl;
+        exit(1);
+    }
+
+    return new ASTNode(ASTNodeOp::A_Builtin, args, nullptr, (int)info->id);
+}
+
+// likely(x) and unlikely(x) once the keyword is read, __builtin_expect(x != 0, 1 or 0) as in the kernel's macros
+ASTNode* Compiler::expect_hint(bool likely) {
+    lparen();
+    ASTNode* test = mknode(ASTNodeOp::A_NotEqual, binexpr(0), mknode(ASTNodeOp::A_IntLit, nullptr, nullptr, 0), 0);
+    rparen();
+    ASTNode* expected = new ASTNode(ASTNodeOp::A_Arg, mknode(ASTNodeOp::A_IntLit, nullptr, nullptr, likely ? 1 : 0), nullptr, 0);
+    return new ASTNode(ASTNodeOp::A_Builtin, new ASTNode(ASTNodeOp::A_Arg, test, expected, 0), nullptr, (int)B_Expect);
+}
+
+// T_Likely or T_Unlikely when a condition is __builtin_expect with a constant, T_EOF for any other
+TokenType expected_branch(ASTNode* cond) {
+    if ((cond->op != ASTNodeOp::A_Builtin) || (get<int>(cond->value) != B_Expect)) {
+        return TokenType::T_EOF;
+    }
+
+    ASTNode* expected = cond->left->right->left;
+
+    if (expected->op != ASTNodeOp::A_IntLit) {
+        return TokenType::T_EOF;
+    }
+
+    return get<int>(expected->value) ? TokenType::T_Likely : TokenType::T_Unlikely;
+}
+
+// A prefetch argument that has to be known at compile time
+int constant_argument(Value* val, int limit, string what, int atLine) {
+    ConstantInt* constant = dyn_cast<ConstantInt>(val);
+
+    if ((!constant) || (constant->getSExtValue() < 0) || (constant->getSExtValue() > limit)) {
+        cerr << "__builtin_prefetch " << what << " must be a constant from 0 to " << limit << " on line " << atLine << endl;
+        exit(1);
+    }
+
+    return constant->getSExtValue();
+}
+
+Value* Compiler::build_builtin(ASTNode* node, IRBuilder<>* builder, LLVMContext* context) {
+    vector<Value*> args;
+    ASTNode* arg = node->left;
+
+    while (arg) {
+        args.push_back(buildAST(arg->left, builder, context));
+        release(arg->left);
+        ASTNode* next = arg->right;
+        delete arg;
+        arg = next;
+    }
+
+    Builtin id = (Builtin)get<int>(node->value);
+    Type* int_type = Type::getInt32Ty(*context);
+
+    // Everything but prefetch and assume works on ints
+    if ((id != B_Prefetch) && (id != B_Assume)) {
+        for (Value* val : args) {
+            int_operand(val);
+        }
+    }
+
+    ConstantInt* known = args.empty() ? nullptr : dyn_cast<ConstantInt>(args[0]);
+
+    switch (id) {
+        case B_Expect:
+            if (known) {
+                return known;
+            }
+
+            return builder->CreateIntrinsic(Intrinsic::expect, {int_type}, args);
+        case B_Popcount:
+            if (known) {
+                return builder->getInt32(known->getValue().countPopulation());
+            }
+
+            return builder->CreateUnaryIntrinsic(Intrinsic::ctpop, args[0]);
+        case B_Clz:
+        case B_Ctz:
+            // Zero has no leading or trailing one, so like GCC's the result for it is undefined
+            if ((known) && (!known->isZero())) {
+                const APInt& bits = known->getValue();
+                return builder->getInt32((id == B_Clz) ? bits.countLeadingZeros() : bits.countTrailingZeros());
+            }
+
+            return builder->CreateIntrinsic((id == B_Clz) ? Intrinsic::ctlz : Intrinsic::cttz, {int_type}, {args[0], builder->getTrue()});
+        case B_Prefetch: {
+            if (!args[0]->getType()->isPointerTy()) {
+                cerr << "__builtin_prefetch needs a pointer on line " << line << endl;
+                exit(1);
+            }
+
+            // Read with the most locality unless told otherwise, and always from the data cache
+            int write = (args.size() > 1) ? constant_argument(args[1], 1, "rw", line) : 0;
+            int locality = (args.size() > 2) ? constant_argument(args[2], 3, "locality", line) : 3;
+            Value* address = builder->CreateBitCast(args[0], builder->getInt8PtrTy());
+            builder->CreateIntrinsic(Intrinsic::prefetch, {address->getType()}, {address, builder->getInt32(write), builder->getInt32(locality), builder->getInt32(1)});
+            return nullptr;
+        }
+        case B_Assume:
+            // Assuming something known to hold says nothing
+            if ((known) && (!known->isZero())) {
+                return nullptr;
+            }
+
+            builder->CreateAssumption(builder->CreateIsNotNull(args[0]));
+            return nullptr;
+        case B_Unreachable:
+            builder->CreateUnreachable();
+
+            // Anything after it is unreachable too, but still needs a block to go in
+            builder->SetInsertPoint(new_block("unreachable.after", builder->GetInsertBlock()));
+            return nullptr;
+    }
+
+    return nullptr;
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "compiler.hpp"
 #include "astNodeOp.hpp"
 #include "tokenType.hpp"
+#include "keywords.hpp"
 #include "astNode.hpp"
 #include <string>
 #include <cstdio>
@@ -21,6 +22,8 @@
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/Host.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/MC/MCSubtargetInfo.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Target/TargetOptions.h>
@@ -30,10 +33,30 @@
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <iterator>
+#include <cstdint>
 using namespace std;
 using namespace llvm;
 
 const int TEXT_LEN_LIMIT = 512;
+const size_t READ_SIZE = 1 << 16;
+
+// Read the next window of the input when it isn't held in memory whole
+bool Compiler::refill() {
+    if ((!inFile.is_open()) || (!inFile)) {
+        return false;
+    }
+
+    source.resize(READ_SIZE);
+    inFile.read(&source[0], READ_SIZE);
+    source.resize(inFile.gcount());
+    pos = 0;
+    return !source.empty();
+}
 
 char Compiler::next() {
     char c;
@@ -44,12 +67,16 @@ char Compiler::next() {
         return c;
     }
 
-    c = inFile.get();
+    if ((pos >= source.size()) && (!refill())) {
+        return '\0';
+    }
+
+    c = source[pos++];
+    column++;
 
     if (c == '\n') {
         line++;
-    } else if (c == EOF) {
-        return '\0';
+        column = 0;
     }
 
     return c;
@@ -65,8 +92,24 @@ char Compiler::skip() {
     return c;
 }
 
+size_t Compiler::offset() {
+    return pos - (putback ? 1 : 0);
+}
+
+void Compiler::rewind(size_t at, int atLine) {
+    pos = at;
+    line = atLine;
+    column = at - (at ? source.rfind('\n', at - 1) + 1 : 0);
+    putback = '\0';
+}
+
 bool Compiler::scan() {
+    // Remember where the previous token ended, statements are delimited by it
+    lastEnd = offset();
+    lastLine = line - (putback == '\n' ? 1 : 0);
     char c = skip();
+    tokenLine = line;
+    tokenColumn = column;
 
     switch (c) {
         case '\0':
@@ -87,6 +130,52 @@ bool Compiler::scan() {
         case ';':
             token.type = TokenType::T_Semi;
             break;
+        case '{':
+            token.type = TokenType::T_LBrace;
+            break;
+        case '}':
+            token.type = TokenType::T_RBrace;
+            break;
+        case '(':
+            token.type = TokenType::T_LParen;
+            break;
+        case ')':
+            token.type = TokenType::T_RParen;
+            break;
+        case '[':
+            token.type = TokenType::T_LBracket;
+            break;
+        case ']':
+            token.type = TokenType::T_RBracket;
+            break;
+        case ',':
+            token.type = TokenType::T_Comma;
+            break;
+        case '&':
+            token.type = TokenType::T_Amper;
+            break;
+        case ':':
+            token.type = TokenType::T_Colon;
+            break;
+        case '.':
+            if ((next() != '.') || (next() != '.')) {
+                cerr << "Unrecognized character . on line " << line << endl;
+                exit(1);
+            }
+
+            token.type = TokenType::T_Ellipsis;
+            break;
+        case '#':
+            // The rest of the line is the directive, the parser makes sense of it
+            text = "";
+
+            while (((c = next()) != '\n') && (c != '\0')) {
+                text += c;
+            }
+
+            putback = c;
+            token.type = TokenType::T_Pragma;
+            break;
         case '=':
             if ((c = next()) == '=') {
                 token.type = TokenType::T_Equal;
@@ -145,6 +234,7 @@ bool Compiler::scan() {
             exit(1);
     }
 
+    stats.tokens++;
     return true;
 }
 
@@ -190,13 +280,7 @@ string Compiler::scanident(char c) {
 }
 
 TokenType Compiler::keyword(string s) {
-    if (s == "print") {
-        return TokenType::T_Print;
-    } else if (s == "int") {
-        return TokenType::T_Int;
-    }
-
-    return TokenType::T_EOF;
+    return keyword_type(s);
 }
 
 ASTNodeOp Compiler::arithop(TokenType tok) {
@@ -216,7 +300,7 @@ int opPrec[] = {
 };
 
 int Compiler::op_precedence(TokenType tok) {
-    int prec = opPrec[tok];
+    int prec = (tok < TokenType::T_IntLit) ? opPrec[tok] : 0;
 
     if (prec == 0) {
         cerr << "Syntax error, token" << ":" << tok << " on line " << line << endl;
@@ -243,24 +327,92 @@ void Compiler::ident() {
     match(TokenType::T_Ident, "identifier");
 }
 
+void Compiler::lbrace() {
+    match(TokenType::T_LBrace, "{");
+}
+
+void Compiler::rbrace() {
+    match(TokenType::T_RBrace, "}");
+}
+
+void Compiler::lparen() {
+    match(TokenType::T_LParen, "(");
+}
+
+void Compiler::rparen() {
+    match(TokenType::T_RParen, ")");
+}
+
+void Compiler::lbracket() {
+    match(TokenType::T_LBracket, "[");
+}
+
+void Compiler::rbracket() {
+    match(TokenType::T_RBracket, "]");
+}
+
 ASTNode* Compiler::primary() {
     ASTNode* node;
     Value* id;
+    Function* fn;
 
     switch (token.type) {
         case TokenType::T_IntLit:
-            node = new ASTNode(ASTNodeOp::A_IntLit, (int)token.intValue);
+            node = mknode(ASTNodeOp::A_IntLit, nullptr, nullptr, (int)token.intValue);
             break;
         case TokenType::T_Ident:
             id = findglobal(text);
 
+            if ((id == nullptr) && (is_builtin(text))) {
+                string name = text;
+                scan();
+                return builtin(name, false);
+            }
+
+            if ((id == nullptr) && ((fn = findfunction(text)) != nullptr)) {
+                scan();
+                return call(fn);
+            }
+
             if (id == nullptr) {
                 cerr << "Unknown variable" << ":" << text << " on line " << line << endl;
                 exit(1);
             }
 
-            node = new ASTNode(ASTNodeOp::A_Ident, id);
+            if (lengths.count(text)) {
+                scan();
+
+                // An array on its own is a pointer to its first element
+                if (token.type != TokenType::T_LBracket) {
+                    return mknode(ASTNodeOp::A_Addr, nullptr, nullptr, id);
+                }
+
+                return index(ASTNodeOp::A_Index, id);
+            }
+
+            if (pointers.count(text)) {
+                scan();
+
+                if (token.type == TokenType::T_LBracket) {
+                    return mknode(ASTNodeOp::A_Deref, pointer_element(id), nullptr, 0);
+                }
+
+                return mknode(ASTNodeOp::A_Ident, nullptr, nullptr, id);
+            }
+
+            node = mknode(ASTNodeOp::A_Ident, nullptr, nullptr, id);
             break;
+        case TokenType::T_Likely:
+        case TokenType::T_Unlikely: {
+            bool likely = (token.type == TokenType::T_Likely);
+            scan();
+            return expect_hint(likely);
+        }
+        case TokenType::T_Star:
+            scan();
+            return mknode(ASTNodeOp::A_Deref, primary(), nullptr, 0);
+        case TokenType::T_Amper:
+            return address();
         default:
             cerr << "syntax error on line " << line << endl;
             exit(1);
@@ -270,21 +422,26 @@ ASTNode* Compiler::primary() {
     return node;
 }
 
+// Tokens that can follow a complete expression
+bool ends_expression(TokenType tok) {
+    return (tok == TokenType::T_Semi) || (tok == TokenType::T_RParen) || (tok == TokenType::T_RBracket) || (tok == TokenType::T_Comma) || (tok == TokenType::T_Colon) || (tok == TokenType::T_Ellipsis);
+}
+
 ASTNode* Compiler::binexpr(int ptp) {
     ASTNode* left = primary();
     TokenType tokenType = token.type;
 
-    if (tokenType == TokenType::T_Semi) {
+    if (ends_expression(tokenType)) {
         return left;
     }
 
     while (op_precedence(tokenType) > ptp) {
         scan();
         ASTNode* right = binexpr(opPrec[tokenType]);
-        left = new ASTNode(arithop(tokenType), left, right, 0);
+        left = mknode(arithop(tokenType), left, right, 0);
         tokenType = token.type;
 
-        if (tokenType == TokenType::T_Semi) {
+        if (ends_expression(tokenType)) {
             return left;
         }
     }
@@ -293,67 +450,246 @@ ASTNode* Compiler::binexpr(int ptp) {
 }
 
 void Compiler::statements(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
-    while (true) {
-        switch (token.type) {
-            case TokenType::T_Print:
-                print_statement(builder, context, printf_type, printf_fn);
-                break;
-            case TokenType::T_Int:
-                var_declaration(builder, context);
-                break;
-            case TokenType::T_Ident:
-                assignment_statement(builder, context);
-                break;
-            case TokenType::T_EOF:
-                return;
-            default:
-                cerr << "Syntax error, token" << ":" << token.type << " on line " << line << endl;
-                exit(1);
-        }
+    PhaseScope phase(timer, Ph_Parse);
+    TimeTraceScope trace("Parse");
+
+    if (options.streamBatch) {
+        streamed_statements(builder, context);
+        return;
+    } else if (options.chunkSize) {
+        outlined_statements(builder, printf_type, printf_fn, context);
+        return;
+    }
+
+    while (single_statement(builder, printf_type, printf_fn, context)) {}
+}
+
+bool Compiler::single_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    TimeTraceScope trace("Statement", [&]() {
+        return "line " + to_string(line);
+    });
+
+    debug_location(builder, tokenLine, tokenColumn);
+
+    // A compound statement runs exactly when its first statement does
+    if ((options.instrument) && (token.type != TokenType::T_EOF) && (token.type != TokenType::T_LBrace)) {
+        count_statement(builder);
+    }
+
+    switch (token.type) {
+        case TokenType::T_Print:
+            print_statement(builder, context, printf_type, printf_fn);
+            return true;
+        case TokenType::T_Int:
+            var_declaration(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_Ident:
+        case TokenType::T_Star:
+            assignment_statement(builder, context);
+            return true;
+        case TokenType::T_LBrace:
+            compound_statement(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_While:
+            while_statement(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_For:
+            for_statement(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_If:
+            if_statement(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_Switch:
+            switch_statement(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_Break:
+            break_statement(builder);
+            return true;
+        case TokenType::T_Parallel:
+            parallel_statement(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_Pragma:
+            pragma_statement(builder, printf_type, printf_fn, context);
+            return true;
+        case TokenType::T_Return:
+            return_statement(builder, context);
+            return true;
+        case TokenType::T_EOF:
+            return false;
+        default:
+            cerr << "Syntax error, token" << ":" << token.type << " on line " << line << endl;
+            exit(1);
     }
 }
 
 void Compiler::print_statement(IRBuilder<>* builder, LLVMContext* context, FunctionType* printf_type, Function* printf_fn) {
     match(TokenType::T_Print, "print");
     ASTNode* tree = binexpr(0);
-    Value* ret_val = buildAST(tree, builder, context);
+    timer.enter(Ph_IRGen);
+    Value* ret_val = int_operand(buildAST(tree, builder, context));
     generatePrint(builder, ret_val, printf_type, printf_fn, context);
-    delete tree;
+    timer.leave();
+    release(tree);
     semi();
 }
 
-void Compiler::var_declaration(IRBuilder<>* builder, LLVMContext* context) {
+void Compiler::var_declaration(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
     match(T_Int, "int");
+    Pointer pointer = declarator();
     ident();
-    addglobal(text, builder, context);
+    string name = text;
+
+    if ((token.type == TokenType::T_LParen) && (pointer == P_None)) {
+        function_definition(name, printf_type, printf_fn, context);
+        return;
+    }
+
+    unsigned length = (token.type == TokenType::T_LBracket) ? array_length() : 0;
+
+    if ((pointer != P_None) && ((length) || (token.type == TokenType::T_LParen))) {
+        cerr << "Only variables can be pointers on line " << line << endl;
+        exit(1);
+    }
+
+    sawDeclaration = true;
+    addglobal(name, length, pointer, builder, context);
     semi();
 }
 
-void Compiler::assignment_statement(IRBuilder<>* builder, LLVMContext* context) {
+ASTNode* Compiler::assignment() {
+    // *p = value, which could store to any variable
+    if (token.type == TokenType::T_Star) {
+        scan();
+        ASTNode* right = mknode(ASTNodeOp::A_LVDeref, primary(), nullptr, 0);
+        match(T_Assign, "=");
+        ASTNode* left = binexpr(0);
+        stored(nullptr);
+        return new ASTNode(A_Assign, left, right, (int)0);
+    }
+
     ident();
     Value* id;
+    Function* fn;
+
+    // A call made for its side effects
+    if ((token.type == TokenType::T_LParen) && (findglobal(text) == nullptr) && (is_builtin(text))) {
+        return builtin(text, true);
+    }
+
+    if ((token.type == TokenType::T_LParen) && (findglobal(text) == nullptr) && ((fn = findfunction(text)) != nullptr)) {
+        return call(fn);
+    }
 
     if ((id = findglobal(text)) == nullptr) {
         cerr << "Undeclared variable" << ":" << text << " on line " << line << endl;
         exit(1);
     }
 
-    ASTNode* right = new ASTNode(ASTNodeOp::A_LVIdent, id);
+    ASTNode* right;
+    Value* var = id;
+
+    if (lengths.count(text)) {
+        right = index(ASTNodeOp::A_LVIndex, id);
+    } else if ((pointers.count(text)) && (token.type == TokenType::T_LBracket)) {
+        right = mknode(ASTNodeOp::A_LVDeref, pointer_element(id), nullptr, 0);
+        var = nullptr;
+    } else {
+        right = new ASTNode(ASTNodeOp::A_LVIdent, id);
+    }
+
     match(T_Assign, "=");
     ASTNode* left = binexpr(0);
-    ASTNode* tree = new ASTNode(A_Assign, left, right, (int)0);
+    stored(var);
+    return new ASTNode(A_Assign, left, right, (int)0);
+}
+
+void Compiler::assignment_statement(IRBuilder<>* builder, LLVMContext* context) {
+    ASTNode* tree = assignment();
+    timer.enter(Ph_IRGen);
     buildAST(tree, builder, context);
-    delete tree;
+    timer.leave();
+    release(tree);
     semi();
 }
 
-void Compiler::addglobal(string global_var, IRBuilder<>* builder, LLVMContext* context) {
-    AllocaInst* inst = builder->CreateAlloca(Type::getInt32Ty(*context), 5);
+void Compiler::addglobal(string global_var, unsigned length, Pointer pointer, IRBuilder<>* builder, LLVMContext* context) {
+    stats.symbols++;
+
+    if (length) {
+        lengths[global_var] = length;
+    } else {
+        lengths.erase(global_var);
+    }
+
+    if (pointer != P_None) {
+        pointers[global_var] = pointer;
+    } else {
+        pointers.erase(global_var);
+    }
+
+    // Streamed batches are separate objects, so the variables are defined once with main
+    if ((options.streamBatch) && (!user_function) && (!parallel_body)) {
+        Type* var_type = symbol_type(global_var, this->context.get());
+        GlobalVariable* var = new GlobalVariable(*module, var_type, false, GlobalValue::ExternalLinkage, Constant::getNullValue(var_type), global_var);
+        var->setVisibility(GlobalValue::HiddenVisibility);
+        var->setAlignment(array_alignment(length));
+        definitions.insert(pair<string, GlobalVariable*>(global_var, var));
+        return;
+    }
+
+    // Outlined chunks all share the program's variables, so they live in the module
+    if ((options.chunkSize) && (!options.incremental) && (!user_function) && (!parallel_body)) {
+        Type* var_type = symbol_type(global_var, context);
+        GlobalVariable* var = new GlobalVariable(*module, var_type, false, GlobalValue::InternalLinkage, Constant::getNullValue(var_type), global_var);
+        var->setAlignment(array_alignment(length));
+        globals.insert(pair<string, Value*>(global_var, var));
+
+        if (pointer == P_Restrict) {
+            restrict_scope(var);
+        }
+
+        return;
+    }
+
+    // Keep allocas in the entry block so they stay static whichever block we're emitting into
+    BasicBlock* entry = &builder->GetInsertBlock()->getParent()->getEntryBlock();
+    IRBuilder<> entry_builder(entry, entry->getFirstInsertionPt());
+    AllocaInst* inst = entry_builder.CreateAlloca(symbol_type(global_var, context));
+
+    if (length) {
+        inst->setAlignment(*array_alignment(length));
+    }
+
     globals.insert(pair<string, Value*>(global_var, inst));
+
+    if (pointer == P_Restrict) {
+        restrict_scope(inst);
+    }
+
+    if (options.incremental) {
+        declared.insert(pair<string, size_t>(global_var, curStmt));
+    }
 }
 
 Value* Compiler::findglobal(string global_var) {
+    // Declare the variable in the batch being streamed the first time it uses it
+    if ((options.streamBatch) && (!user_function) && (!globals.count(global_var)) && (definitions.count(global_var))) {
+        GlobalVariable* var = definitions.at(global_var);
+        GlobalVariable* decl = cast<GlobalVariable>(batch_module->getOrInsertGlobal(var->getName(), symbol_type(global_var, &batch_module->getContext())));
+        decl->setAlignment(var->getAlign());
+        globals.insert(pair<string, Value*>(global_var, decl));
+
+        if ((pointers.count(global_var)) && (pointers.at(global_var) == P_Restrict)) {
+            restrict_scope(decl);
+        }
+    }
+
     try {
+        // When re-parsing part of the program, only declarations before it are in scope
+        if ((options.incremental) && (declared.at(global_var) >= visibleDecls)) {
+            return nullptr;
+        }
+
         return globals.at(global_var);
     } catch (const out_of_range& err) {
         return nullptr;
@@ -363,17 +699,52 @@ Value* Compiler::findglobal(string global_var) {
 }
 
 Value* Compiler::buildAST(ASTNode* node, IRBuilder<>* builder, LLVMContext* context) {
-    Value* leftVal;
-    Value* rightVal;
+    Value* leftVal = nullptr;
+    Value* rightVal = nullptr;
+
+    // Arguments are a list rather than two operands
+    if (node->op == ASTNodeOp::A_Call) {
+        return build_call(node, builder, context);
+    }
+
+    if (node->op == ASTNodeOp::A_Builtin) {
+        return build_builtin(node, builder, context);
+    }
+
+    // A node shared by --dag may already have been built in this block
+    if (node->refs) {
+        if (Value* val = reuse(node, builder)) {
+            return val;
+        }
+    }
 
     if (node->left) {
         leftVal = buildAST(node->left, builder, context);
-        delete node->left;
     }
 
     if (node->right) {
         rightVal = buildAST(node->right, builder, context);
-        delete node->right;
+    }
+
+    // Shared nodes keep their operands, everything else is done with them
+    if (!node->refs) {
+        release(node->left);
+        release(node->right);
+        return build_op(node, leftVal, rightVal, builder, context);
+    }
+
+    Value* val = build_op(node, leftVal, rightVal, builder, context);
+    remember(node, val, builder);
+    return val;
+}
+
+Value* Compiler::build_op(ASTNode* node, Value* leftVal, Value* rightVal, IRBuilder<>* builder, LLVMContext* context) {
+    Instruction* access;
+    Value* address;
+
+    // Operators with a pointer on either side do pointer arithmetic or compare addresses
+    if ((node->op < ASTNodeOp::A_IntLit) && ((leftVal->getType()->isPointerTy()) || (rightVal->getType()->isPointerTy()))) {
+        return pointer_op(node, leftVal, rightVal, builder);
     }
 
     switch (node->op) {
@@ -390,22 +761,53 @@ Value* Compiler::buildAST(ASTNode* node, IRBuilder<>* builder, LLVMContext* cont
         case ASTNodeOp::A_LVIdent:
             return get<Value*>(node->value);
         case ASTNodeOp::A_Assign:
-            builder->CreateStore(leftVal, rightVal);
+            if (leftVal->getType() != rightVal->getType()->getPointerElementType()) {
+                cerr << "Incompatible types in assignment on line " << line << endl;
+                exit(1);
+            }
+
+            access = builder->CreateStore(leftVal, rightVal);
+            alias_metadata(access, rightVal);
             return nullptr;
         case ASTNodeOp::A_Ident:
-            return builder->CreateLoad(Type::getInt32Ty(*context), get<Value*>(node->value));
+            access = builder->CreateLoad(storage_type(get<Value*>(node->value)), get<Value*>(node->value));
+            alias_metadata(access, get<Value*>(node->value));
+            return access;
+        case ASTNodeOp::A_Index:
+            address = element(builder, get<Value*>(node->value), int_operand(leftVal));
+            access = builder->CreateLoad(Type::getInt32Ty(*context), address);
+            alias_metadata(access, address);
+            return access;
+        case ASTNodeOp::A_LVIndex:
+            return element(builder, get<Value*>(node->value), int_operand(leftVal));
+        case ASTNodeOp::A_Addr:
+            return address_of(builder, get<Value*>(node->value));
+        case ASTNodeOp::A_Deref:
+        case ASTNodeOp::A_LVDeref:
+            if (!leftVal->getType()->isPointerTy()) {
+                cerr << "Dereferencing an int on line " << line << endl;
+                exit(1);
+            }
+
+            if (node->op == ASTNodeOp::A_LVDeref) {
+                return leftVal;
+            }
+
+            access = builder->CreateLoad(Type::getInt32Ty(*context), leftVal);
+            alias_metadata(access, leftVal);
+            return access;
         case ASTNodeOp::A_Equal:
-            return builder->CreateICmpEQ(leftVal, rightVal);
+            return builder->CreateZExt(builder->CreateICmpEQ(leftVal, rightVal), Type::getInt32Ty(*context));
         case ASTNodeOp::A_NotEqual:
-            return builder->CreateICmpNE(leftVal, rightVal);
+            return builder->CreateZExt(builder->CreateICmpNE(leftVal, rightVal), Type::getInt32Ty(*context));
         case ASTNodeOp::A_LessThan:
-            return builder->CreateICmpSLT(leftVal, rightVal);
+            return builder->CreateZExt(builder->CreateICmpSLT(leftVal, rightVal), Type::getInt32Ty(*context));
         case ASTNodeOp::A_LessEqual:
-            return builder->CreateICmpSLE(leftVal, rightVal);
+            return builder->CreateZExt(builder->CreateICmpSLE(leftVal, rightVal), Type::getInt32Ty(*context));
         case ASTNodeOp::A_GreaterThan:
-            return builder->CreateICmpSGT(leftVal, rightVal);
+            return builder->CreateZExt(builder->CreateICmpSGT(leftVal, rightVal), Type::getInt32Ty(*context));
         case ASTNodeOp::A_GreaterEqual:
-            return builder->CreateICmpSGE(leftVal, rightVal);
+            return builder->CreateZExt(builder->CreateICmpSGE(leftVal, rightVal), Type::getInt32Ty(*context));
         default:
             cerr << "unreocnigzed node in ast " << node->op << endl;
             exit(1);
@@ -413,33 +815,29 @@ Value* Compiler::buildAST(ASTNode* node, IRBuilder<>* builder, LLVMContext* cont
 }
 
 void Compiler::generatePrint(IRBuilder<>* builder, Value* val, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    // A shared object prints through the host's callback
+    if (options.sharedObject) {
+        print_callback(builder, val);
+        return;
+    }
+
+    // The runtime's printer takes the number itself
+    if (options.freestanding) {
+        builder->CreateCall(printf_type, printf_fn, {val});
+        return;
+    }
+
     Constant* format_const = ConstantDataArray::getString(*context, "%d\n");
-    AllocaInst* var_ptr = builder->CreateAlloca(ArrayType::get(IntegerType::get(*context, 8), 4), 5);
+    AllocaInst* var_ptr = builder->CreateAlloca(ArrayType::get(IntegerType::get(*context, 8), 4));
     builder->CreateStore(format_const, var_ptr);
     Value* fmt_arg = builder->CreateBitCast(var_ptr, Type::getInt8PtrTy(*context));
     Value* printf_args[] = {fmt_arg, val};
     builder->CreateCall(printf_type, printf_fn, printf_args);
 }
 
-void Compiler::parse() {
-    // Initialize everything
-    InitializeAllTargetInfos();
-    InitializeAllTargets();
-    InitializeAllTargetMCs();
-    InitializeAllAsmParsers();
-    InitializeAllAsmPrinters();
-
-    // Create context
-    LLVMContext main_context;
-
-    // Create module
-    Module main_module("main_module", main_context);
-
-    // Set module triple
-    string triple = sys::getDefaultTargetTriple();
-    main_module.setTargetTriple(triple);
-
+TargetMachine* Compiler::create_machine() {
     // Get target from triple
+    string triple = sys::getDefaultTargetTriple();
     string error_str;
     Target* target = (Target*)TargetRegistry::lookupTarget(triple, error_str);
 
@@ -448,69 +846,330 @@ void Compiler::parse() {
         exit(1);
     }
 
+    // native spells out the host's features, so the output doesn't depend on what the CPU name implies
+    string cpu_name = options.cpu;
+    string features;
+
+    if (cpu_name == "native") {
+        cpu_name = sys::getHostCPUName().str();
+        StringMap<bool> host_features;
+
+        if (sys::getHostCPUFeatures(host_features)) {
+            for (auto& feature : host_features) {
+                features += string(features.empty() ? "" : ",") + (feature.second ? "+" : "-") + feature.first().str();
+            }
+        }
+    }
+
+    if (!options.features.empty()) {
+        features += string(features.empty() ? "" : ",") + options.features;
+    }
+
     // Create target machine
-    string cpu_name = sys::getHostCPUName().str();
     TargetOptions opt;
     Optional<Reloc::Model> RM;
-    TargetMachine* machine = target->createTargetMachine(triple, cpu_name, "", opt, RM);
-    main_module.setDataLayout(machine->createDataLayout());
 
-    // Create builder
-    IRBuilder<> builder(main_context);
+    if (options.sharedObject) {
+        RM = Reloc::PIC_;
+    }
+
+    TargetMachine* tm = target->createTargetMachine(triple, cpu_name, features, opt, RM);
+
+    if (!tm->getMCSubtargetInfo()->isCPUStringValid(cpu_name)) {
+        cerr << "Unknown CPU " << cpu_name << " for " << triple << endl;
+        exit(1);
+    }
+
+    return tm;
+}
+
+void Compiler::setup() {
+    PhaseScope phase(timer, Ph_Setup);
+    TimeTraceScope trace("Setup");
+
+    if (!machine) {
+        // Initialize everything
+        InitializeAllTargetInfos();
+        InitializeAllTargets();
+        InitializeAllTargetMCs();
+        InitializeAllAsmParsers();
+        InitializeAllAsmPrinters();
+    }
+
+    // Create context, dropping any module from a previous build first
+    module.reset();
+    scopes.clear();
+    scope_domain = nullptr;
+    context = make_unique<LLVMContext>();
+    remark_handler(context.get());
+
+    // Create module
+    module = make_unique<Module>("main_module", *context);
+
+    if (options.debugInfo) {
+        debug_module(module.get());
+    }
+
+    // Set module triple
+    string triple = sys::getDefaultTargetTriple();
+    module->setTargetTriple(triple);
+
+    if (!machine) {
+        machine = create_machine();
+    }
+
+    module->setDataLayout(machine->createDataLayout());
 
     // Setup printf function
-    Type* printf_arg_types[] = {Type::getInt8PtrTy(main_context)};
-    FunctionType* printf_type = FunctionType::get(Type::getInt32Ty(main_context), printf_arg_types, true);
-    Function* printf_func = Function::Create(printf_type, Function::ExternalLinkage, 0, Twine("printf"), &main_module);
+    printf_func = declare_print(module.get());
+    printf_type = printf_func->getFunctionType();
 
-    // Setup main function
+    // Setup main function, or for a shared object the run function the host calls
     vector<Type*> main_args;
-    main_args.push_back(Type::getInt32Ty(main_context));
-    main_args.push_back(PointerType::get(PointerType::get((Type*)Type::getInt8Ty(main_context), 0), 0));
-    FunctionType* main_ft = FunctionType::get(Type::getInt32Ty(main_context), main_args, false);
-    Function* main_function = Function::Create(main_ft, Function::CommonLinkage, "main", &main_module);
-    BasicBlock* main_bb = BasicBlock::Create(main_context, "entry", main_function);
+    string main_name = "main";
+
+    if (options.sharedObject) {
+        module->setPICLevel(PICLevel::BigPIC);
+        main_args.push_back(Type::getInt8PtrTy(*context));
+        main_name = RUN_NAME;
+    } else {
+        main_args.push_back(Type::getInt32Ty(*context));
+        main_args.push_back(PointerType::get(PointerType::get((Type*)Type::getInt8Ty(*context), 0), 0));
+    }
+
+    FunctionType* main_ft = FunctionType::get(Type::getInt32Ty(*context), main_args, false);
+    main_function = Function::Create(main_ft, Function::ExternalLinkage, main_name, module.get());
+    debug_function(main_function, 1);
+    BasicBlock::Create(*context, "entry", main_function);
+
+    if (options.sharedObject) {
+        enter_run();
+    }
+
+    if (options.freestanding) {
+        freestanding_runtime(module.get());
+    }
+}
+
+void Compiler::parse() {
+    setup();
+
+    // Create builder
+    IRBuilder<> builder(*context);
+    BasicBlock* main_bb = &main_function->getEntryBlock();
     builder.SetInsertPoint(main_bb);
 
     // Compile code
-    statements(&builder, printf_type, printf_func, &main_context);
+    if (options.incremental) {
+        // Give every statement its own blocks so it can be replaced later
+        exit_bb = BasicBlock::Create(*context, "exit", main_function);
+        visibleDecls = SIZE_MAX;
+        size_t reused;
+        stmts = incremental_statements(&builder, 0, SIZE_MAX, 0, &reused);
+        link_statements(main_bb, stmts.begin(), stmts.end(), exit_bb);
+        builder.SetInsertPoint(exit_bb);
+    } else {
+        statements(&builder, printf_type, printf_func, context.get());
+    }
+
+    finish(&builder);
+}
 
+void Compiler::finish(IRBuilder<>* builder) {
     // Return result from main
-    builder.CreateRet(builder.getInt32(0));
+    if (options.sharedObject) {
+        leave_run(builder);
+    }
+
+    builder->CreateRet(builder->getInt32(0));
+
+    if (options.instrument) {
+        finish_counters();
+    }
 
     // Make sure the function is fine
-    verifyFunction(*main_function);
+    verify(main_function);
+    debug_finish();
+}
 
-    // Create outstream
-    error_code EC;
-    raw_fd_ostream dest("output.o", EC, sys::fs::OF_None);
+void Compiler::verify(Function* fn) {
+    PhaseScope phase(timer, Ph_Verify);
+    TimeTraceScope trace("Verify", fn->getName());
 
-    if (EC) {
-        cerr << "Could not open file: " << EC.message() << endl;
-        exit(1);
+    // The subprogram's node lists are placeholders until it's finalized
+    if ((dibuilder) && (fn->getSubprogram())) {
+        dibuilder->finalizeSubprogram(fn->getSubprogram());
+    }
+
+    verifyFunction(*fn, &errs());
+}
+
+void Compiler::emit(string outName) {
+    // Code generation rewrites the IR, so incremental builds keep their copy intact for the next update
+    Module* mod = module.get();
+    unique_ptr<Module> copy;
+
+    if (options.incremental) {
+        copy = CloneModule(*module);
+        mod = copy.get();
     }
 
+    multiversion(mod);
+
+    if (options.threads > 1) {
+        emit_parallel(mod, outName);
+    } else {
+        emit_module(mod, outName);
+    }
+
+    if (!options.executable.empty()) {
+        link_executable();
+    }
+}
+
+void Compiler::emit_module(Module* mod, string outName) {
+    optimize(mod);
+    PhaseScope phase(timer, Ph_CodeGen);
+    TimeTraceScope trace("CodeGen", outName);
+
+    // Create outstream
+    unique_ptr<raw_pwrite_stream> dest = object_stream(outName);
     legacy::PassManager pass;
     CodeGenFileType fileType = CGFT_ObjectFile;
 
-    if (machine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
+    if (machine->addPassesToEmitFile(pass, *dest, nullptr, fileType)) {
         cerr << "Target machine can't emit a file of this type" << endl;
         exit(1);
     }
 
-    pass.run(main_module);
-    dest.flush();
+    stats.instructions += mod->getInstructionCount();
+    pass.run(*mod);
+    dest->flush();
+    stats.objects++;
+    stats.objectBytes += dest->tell();
 }
 
-Compiler::Compiler(string filename) {
-    inFile.open(filename);
+string readfile(string filename) {
+    ifstream inFile(filename, ios::binary);
+
+    if (!inFile) {
+        cerr << "Unable to load file " << filename << endl;
+        exit(1);
+    }
+
+    return string(istreambuf_iterator<char>(inFile), istreambuf_iterator<char>());
+}
+
+Compiler::Compiler(string filename, Options options) : filename(filename), options(options) {
+    // Incremental builds diff against the whole source, everything else reads it a window at a time
+    if (options.incremental) {
+        source = readfile(filename);
+    } else {
+        inFile.open(filename, ios::binary);
+
+        if (!inFile) {
+            cerr << "Unable to load file " << filename << endl;
+            exit(1);
+        }
+    }
+
+    pos = 0;
+    lastEnd = 0;
+    lastLine = 1;
     line = 1;
-    putback = '\n';
+    column = 0;
+    tokenLine = 1;
+    tokenColumn = 0;
+    putback = '\0';
     token = Token(TokenType::T_EOF, 0);
+    sawDeclaration = false;
+    user_function = nullptr;
+    parallel_body = nullptr;
+    machine = nullptr;
+
+    if (options.timeReport) {
+        timer.enable();
+        TimePassesIsEnabled = true;
+    }
+
+    printf_type = nullptr;
+    printf_func = nullptr;
+    main_function = nullptr;
+    difile = nullptr;
+    run_context = nullptr;
+    outer_context = nullptr;
+    countedBlock = nullptr;
+    scope_domain = nullptr;
+    visibleDecls = SIZE_MAX;
+    curStmt = 0;
+    exit_bb = nullptr;
+    batch_module = nullptr;
+    chunks = 0;
+    builtCount = 0;
 }
 
-void Compiler::run() {
+Compiler::~Compiler() {
+    dag_reset();
+    dibuilder.reset();
+    module.reset();
+    context.reset();
+    delete machine;
+}
+
+PhaseTimer& Compiler::phases() {
+    return timer;
+}
+
+// Times a pass of the lexer over the whole source and rewinds, returning the seconds it took
+double Compiler::lex() {
+    size_t tokens = stats.tokens;
+    double before = timer.elapsed(Ph_Lex);
+
+    {
+        PhaseScope phase(timer, Ph_Lex);
+        while (scan()) {}
+    }
+
+    // Back to the start, reading the file again when it's read a window at a time
+    if (inFile.is_open()) {
+        inFile.clear();
+        inFile.seekg(0);
+        source.clear();
+    }
+
+    rewind(0, 1);
+    stats.tokens = tokens;
+    return timer.elapsed(Ph_Lex) - before;
+}
+
+void Compiler::build() {
+    // Clocking every token would time the clock, so lexing is timed once up front and taken back
+    // off parsing, which lexes again as it goes
+    double lexed = 0;
+
+    if (timer.is_enabled()) {
+        lexed = lex();
+    }
+
     scan();
     parse();
-    inFile.close();
+    timer.deduct(Ph_Parse, lexed);
+}
+
+void Compiler::run() {
+    build();
+    emit(options.output);
+
+    if (options.timeReport) {
+        timer.report(errs());
+        reportAndResetTimings(&errs());
+    }
+
+    if (options.stats) {
+        stats.report(errs());
+    }
+
+    if (!options.statsJson.empty()) {
+        stats.write_json(options.statsJson);
+    }
 }
\ No newline at end of file
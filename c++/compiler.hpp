@@ -4,54 +4,266 @@
 #include <string>
 #include "astNodeOp.hpp"
 #include "astNode.hpp"
+#include "statement.hpp"
+#include "loopHints.hpp"
+#include "pointer.hpp"
+#include "parallel.hpp"
+#include "options.hpp"
+#include "timing.hpp"
+#include "stats.hpp"
 #include <llvm/IR/Value.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/MapVector.h>
+#include <llvm/Support/raw_ostream.h>
 #include <map>
+#include <memory>
+#include <vector>
+#include <tuple>
 using namespace std;
 using namespace llvm;
 
+string readfile(string filename);
+string partname(string outName, unsigned part);
+MaybeAlign array_alignment(unsigned length);
+Type* storage_type(Value* var);
+bool valid_clones(vector<string> cpus);
+bool is_builtin(string name);
+TokenType expected_branch(ASTNode* cond);
+void parallel_bodies(BasicBlock* block, vector<Function*>* bodies);
+extern const char* RUN_NAME;
+extern const char* PARALLEL_NAME;
+
+// What makes two --dag nodes the same: operator, operands, literal or variable, and the variable's store count
+typedef tuple<unsigned, ASTNode*, ASTNode*, intptr_t, unsigned> DAGKey;
+
+// Where a --dag node's IR was built, and how many values had been built before it
+struct BuiltValue {
+    Value* value;
+    BasicBlock* block;
+    size_t at;
+};
+
 class Compiler {
 private:
+    string filename;
+    Options options;
+    PhaseTimer timer;
+    Stats stats;
     ifstream inFile;
+    string source;
+    size_t pos;
+    size_t lastEnd;
+    int lastLine;
     int line;
+    int column;
+    int tokenLine;
+    int tokenColumn;
     char putback;
     Token token;
+    LoopHints hints;
+    bool sawDeclaration;
     map<string, Value*> globals;
+    map<string, GlobalVariable*> definitions;
+    map<string, unsigned> lengths;
+    map<string, Pointer> pointers;
     string text;
 
+    unique_ptr<LLVMContext> context;
+    unique_ptr<Module> module;
+    TargetMachine* machine;
+    FunctionType* printf_type;
+    Function* printf_func;
+    Function* main_function;
+
+    // Debug info for the module being built, only with -g
+    unique_ptr<DIBuilder> dibuilder;
+    DIFile* difile;
+
+    // Thread's current run() context and the one it replaced, only with -shared
+    GlobalVariable* run_context;
+    Value* outer_context;
+
+    // Source line of each statement and the counter of the block it starts in, only with
+    // --instrument-statements. Each counter is a local of its function until it returns, and the
+    // last block counted is shared by the statements after it
+    vector<int> counterLines;
+    vector<unsigned> statementCounters;
+    vector<AllocaInst*> counterSlots;
+    BasicBlock* countedBlock;
+
+    // Functions the program defines, and the one whose body is being parsed
+    map<string, Function*> functions;
+    map<string, vector<Pointer>> signatures;
+    Function* user_function;
+
+    // Outlined body of the parallel for being parsed, which can't return or break out of it
+    Function* parallel_body;
+
+    // Where break goes in each loop and switch the statement being parsed is in
+    vector<BasicBlock*> breaks;
+
+    // Incremental state, only kept when compiling incrementally
+    vector<Statement> stmts;
+    map<string, size_t> declared;
+    size_t visibleDecls;
+    size_t curStmt;
+    BasicBlock* exit_bb;
+
+    // Streaming state, the module the current batch of statements goes into
+    Module* batch_module;
+    size_t chunks;
+
+    // Hash-consed expressions, the IR each was last built into and in which block, only with --dag
+    DenseMap<DAGKey, ASTNode*> dag;
+    DenseMap<ASTNode*, BuiltValue> built;
+    DenseMap<Value*, unsigned> versions;
+    size_t builtCount;
+
+    // Alias scope of each restrict-qualified local of the function being built, by its storage
+    MapVector<Value*, MDNode*> scopes;
+    MDNode* scope_domain;
+
+    // Objects kept in memory for the linker, only when building an executable
+    vector<unique_ptr<SmallVector<char, 0>>> objects;
+
+    bool refill();
     char next();
     char skip();
     bool scan();
+    double lex();
     int scanint(char c);
     string scanident(char c);
     TokenType keyword(string s);
+    size_t offset();
+    void rewind(size_t at, int atLine);
 
     int op_precedence(TokenType tok);
 
     void match(TokenType ttype, string tstr);
     void semi();
     void ident();
+    void lbrace();
+    void rbrace();
+    void lparen();
+    void rparen();
+    void lbracket();
+    void rbracket();
+    Pointer declarator();
 
     ASTNodeOp arithop(TokenType tok);
     ASTNode* primary();
     ASTNode* binexpr(int ptp);
+    ASTNode* index(ASTNodeOp op, Value* array);
+    ASTNode* arguments(size_t* count);
+    ASTNode* call(Function* fn);
+    ASTNode* builtin(string name, bool statement);
+    ASTNode* expect_hint(bool likely);
+    ASTNode* address();
+    ASTNode* pointer_element(Value* ptr);
 
     void statements(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    bool single_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
     void print_statement(IRBuilder<>* builder, LLVMContext* context, FunctionType* printf_type, Function* printf_fn);
-    void var_declaration(IRBuilder<>* builder, LLVMContext* context);
+    void var_declaration(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void function_definition(string name, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void return_statement(IRBuilder<>* builder, LLVMContext* context);
+    ASTNode* assignment();
     void assignment_statement(IRBuilder<>* builder, LLVMContext* context);
+    void compound_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void while_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void for_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void if_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void switch_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    int64_t case_value(IRBuilder<>* builder, LLVMContext* context);
+    void break_statement(IRBuilder<>* builder);
+    void parallel_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void reduction_clause(vector<Reduction>* reductions);
+    void pragma_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void loop(IRBuilder<>* builder, ASTNode* cond, ASTNode* post, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    BasicBlock* new_block(string name, BasicBlock* after);
 
-    void addglobal(string global_var, IRBuilder<>* builder, LLVMContext* context);
+    void addglobal(string global_var, unsigned length, Pointer pointer, IRBuilder<>* builder, LLVMContext* context);
     Value* findglobal(string global_var);
+    unsigned array_length();
+    Type* symbol_type(string global_var, LLVMContext* context);
+    Value* element(IRBuilder<>* builder, Value* array, Value* at);
+    Function* findfunction(string name);
+    Value* build_call(ASTNode* node, IRBuilder<>* builder, LLVMContext* context);
+    Function* declare_function(string name, vector<Pointer> params, Module* mod);
+    Value* build_builtin(ASTNode* node, IRBuilder<>* builder, LLVMContext* context);
+
+    Value* int_operand(Value* val);
+    Value* address_of(IRBuilder<>* builder, Value* var);
+    Value* pointer_op(ASTNode* node, Value* leftVal, Value* rightVal, IRBuilder<>* builder);
+    void restrict_scope(Value* var);
+    void alias_metadata(Instruction* access, Value* address);
+
+    ASTNode* mknode(ASTNodeOp op, ASTNode* left, ASTNode* right, ASTValue value);
+    void stored(Value* var);
+    void release(ASTNode* node);
+    void dag_reset();
+    Value* reuse(ASTNode* node, IRBuilder<>* builder);
+    void remember(ASTNode* node, Value* val, IRBuilder<>* builder);
 
     Value* buildAST(ASTNode* node, IRBuilder<>* builder, LLVMContext* context);
+    Value* build_op(ASTNode* node, Value* leftVal, Value* rightVal, IRBuilder<>* builder, LLVMContext* context);
     void generatePrint(IRBuilder<>* builder, Value* val, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
 
+    vector<Function*> outline(IRBuilder<>* builder, Module* mod, size_t limit, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void outlined_statements(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context);
+    void streamed_statements(IRBuilder<>* builder, LLVMContext* context);
+
+    void debug_module(Module* mod);
+    void debug_function(Function* fn, int atLine);
+    void debug_location(IRBuilder<>* builder, int atLine, int atColumn);
+    void debug_finish();
+
+    Function* declare_print(Module* mod);
+    void freestanding_runtime(Module* mod);
+    Function* parallel_runtime(Module* mod);
+
+    void enter_run();
+    void leave_run(IRBuilder<>* builder);
+    void print_callback(IRBuilder<>* builder, Value* val);
+
+    void count_statement(IRBuilder<>* builder);
+    void merge_counters(IRBuilder<>* builder);
+    void flush_counters(Module* mod);
+    void finish_counters();
+
+    TargetMachine* create_machine();
+    void setup();
     void parse();
+    void finish(IRBuilder<>* builder);
+    void verify(Function* fn);
+
+    vector<Statement> incremental_statements(IRBuilder<>* builder, size_t first, size_t stop, long delta, size_t* reused);
+    void link_statements(BasicBlock* from, vector<Statement>::iterator first, vector<Statement>::iterator last, BasicBlock* to);
+    void erase_statements(vector<Statement>::iterator first, vector<Statement>::iterator last);
+    void rebuild();
+    bool update_compiles(const string& newSource);
+
+    void multiversion(Module* mod);
+    void remark_handler(LLVMContext* ctx);
+    void optimize(Module* mod);
+    void emit_module(Module* mod, string outName);
+    void emit_parallel(Module* mod, string outName);
+    unique_ptr<raw_pwrite_stream> object_stream(string outName);
+    void link_executable();
 public:
-    Compiler(string filename);
+    Compiler(string filename, Options options = Options());
+    ~Compiler();
     void run();
+    void build();
+    void emit(string outName);
+    size_t update(string newSource);
+    void watch();
+    PhaseTimer& phases();
 };
\ No newline at end of file
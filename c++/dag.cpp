@@ -0,0 +1,138 @@
+#include "compiler.hpp"
+#include <vector>
+#include <variant>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+using namespace std;
+using namespace llvm;
+
+// Shared nodes the table holds on to before it's emptied, bounding the front end's memory
+const size_t DAG_TABLE_LIMIT = 1024;
+
+// How many values back a shared node's IR is still reused. Reaching further saves a little more IR,
+// but the long-lived values join up into closures that X86's domain reassignment pass takes
+// quadratic time over on AVX-512 targets, ten times the whole of code generation at 256
+const size_t DAG_REUSE_WINDOW = 16;
+
+// Operators whose value depends only on their operands and the variables they read
+bool pure_op(ASTNodeOp op) {
+    switch (op) {
+        case ASTNodeOp::A_Add:
+        case ASTNodeOp::A_Subtract:
+        case ASTNodeOp::A_Multiply:
+        case ASTNodeOp::A_Divide:
+        case ASTNodeOp::A_Equal:
+        case ASTNodeOp::A_NotEqual:
+        case ASTNodeOp::A_LessThan:
+        case ASTNodeOp::A_GreaterThan:
+        case ASTNodeOp::A_LessEqual:
+        case ASTNodeOp::A_GreaterEqual:
+        case ASTNodeOp::A_IntLit:
+        case ASTNodeOp::A_Ident:
+        case ASTNodeOp::A_Index:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// A new node, or with --dag the one already made for the same pure expression. Reads are keyed on
+// how many stores their variable has seen, so a read after a store never shares with one before it
+ASTNode* Compiler::mknode(ASTNodeOp op, ASTNode* left, ASTNode* right, ASTValue value) {
+    if ((!options.dag) || (!pure_op(op)) || ((left) && (!left->refs)) || ((right) && (!right->refs))) {
+        return new ASTNode(op, left, right, value);
+    }
+
+    Value* var = holds_alternative<Value*>(value) ? get<Value*>(value) : nullptr;
+    intptr_t id = var ? (intptr_t)var : get<int>(value);
+    DAGKey key((unsigned)op, left, right, id, var ? versions.lookup(var) : 0);
+    auto found = dag.find(key);
+
+    // The node already holds operands of its own
+    if (found != dag.end()) {
+        release(left);
+        release(right);
+        found->second->refs++;
+        stats.sharedNodes++;
+        return found->second;
+    }
+
+    if (dag.size() >= DAG_TABLE_LIMIT) {
+        dag_reset();
+    }
+
+    // One reference for the table, one for the caller
+    ASTNode* node = new ASTNode(op, left, right, value);
+    node->refs = 2;
+    dag[key] = node;
+    return node;
+}
+
+// Reads of the variable from here on see a new value. A store through a pointer could have
+// changed any variable, so nothing read before it is shared with what's read after
+void Compiler::stored(Value* var) {
+    if (!options.dag) {
+        return;
+    }
+
+    if (!var) {
+        dag_reset();
+        return;
+    }
+
+    versions[var]++;
+}
+
+// Drops a reference to a node. A node with a single owner is just deleted, buildAST has already
+// released its operands, while a shared one goes with its operands once nothing refers to it
+void Compiler::release(ASTNode* node) {
+    if (!node) {
+        return;
+    }
+
+    if (!node->refs) {
+        delete node;
+        return;
+    }
+
+    if (--node->refs) {
+        return;
+    }
+
+    release(node->left);
+    release(node->right);
+    built.erase(node);
+    delete node;
+}
+
+// Empties the table, nodes still in a tree waiting to be built outlive it
+void Compiler::dag_reset() {
+    vector<ASTNode*> nodes;
+
+    for (auto& entry : dag) {
+        nodes.push_back(entry.second);
+    }
+
+    dag.clear();
+
+    for (ASTNode* node : nodes) {
+        release(node);
+    }
+}
+
+// The value a shared node was given recently in the block being built, if any. Anywhere else it
+// might not dominate the use, so the node is built again
+Value* Compiler::reuse(ASTNode* node, IRBuilder<>* builder) {
+    auto found = built.find(node);
+
+    if ((found == built.end()) || (found->second.block != builder->GetInsertBlock()) || (builtCount - found->second.at > DAG_REUSE_WINDOW)) {
+        return nullptr;
+    }
+
+    stats.reusedValues++;
+    return found->second.value;
+}
+
+void Compiler::remember(ASTNode* node, Value* val, IRBuilder<>* builder) {
+    built[node] = {val, builder->GetInsertBlock(), builtCount++};
+}
\ No newline at end of file
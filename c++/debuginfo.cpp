@@ -0,0 +1,53 @@
+#include "compiler.hpp"
+#include <string>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/DebugLoc.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/ADT/SmallString.h>
+using namespace std;
+using namespace llvm;
+
+// Start describing a module's functions, each module needs a compile unit of its own
+void Compiler::debug_module(Module* mod) {
+    dibuilder = make_unique<DIBuilder>(*mod);
+
+    SmallString<128> path(filename);
+    sys::fs::make_absolute(path);
+    difile = dibuilder->createFile(sys::path::filename(path), sys::path::parent_path(path));
+    dibuilder->createCompileUnit(dwarf::DW_LANG_C99, difile, "multi-c-compiler", false, "", 0, "", DICompileUnit::LineTablesOnly);
+
+    mod->addModuleFlag(Module::Warning, "Dwarf Version", 4);
+    mod->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+}
+
+void Compiler::debug_function(Function* fn, int atLine) {
+    if (!dibuilder) {
+        return;
+    }
+
+    DIBasicType* int_type = dibuilder->createBasicType("int", 32, dwarf::DW_ATE_signed);
+    DISubroutineType* fn_type = dibuilder->createSubroutineType(dibuilder->getOrCreateTypeArray({int_type}));
+    DISubprogram* sp = dibuilder->createFunction(difile, fn->getName(), fn->getName(), difile, atLine, fn_type, atLine, DINode::FlagPrototyped, DISubprogram::SPFlagDefinition);
+    fn->setSubprogram(sp);
+}
+
+// Everything the builder creates from here on is attributed to this source position
+void Compiler::debug_location(IRBuilder<>* builder, int atLine, int atColumn) {
+    if (!dibuilder) {
+        return;
+    }
+
+    DISubprogram* sp = builder->GetInsertBlock()->getParent()->getSubprogram();
+    builder->SetCurrentDebugLocation(DILocation::get(builder->getContext(), atLine, atColumn, sp));
+}
+
+void Compiler::debug_finish() {
+    if (dibuilder) {
+        dibuilder->finalize();
+    }
+}
\ No newline at end of file
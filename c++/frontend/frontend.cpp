@@ -0,0 +1,471 @@
+#include "frontend.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <cctype>
+#include <exception>
+using namespace std;
+
+const int TEXT_LEN_LIMIT = 512;
+
+// Errors unwind back to front_parse, a library can't exit the process it's loaded into
+struct FrontError {
+    string message;
+};
+
+class Frontend {
+private:
+    const char* source;
+    size_t length;
+    size_t pos;
+    int line;
+    char putback;
+    size_t current;
+    unordered_map<string, int32_t> names;
+    unordered_map<int32_t, int32_t> symbolOf;
+
+    char next();
+    char skip();
+    void scan_token();
+    int32_t scanint(char c);
+    int32_t scanident(char c);
+    int keyword(const char* s);
+
+    const FrontToken& token();
+    void scan();
+    void fail(string message);
+    void match(int ttype, string tstr);
+
+    int32_t add_node(int op, int32_t left, int32_t mid, int32_t right, int32_t value);
+    int op_precedence(int tok);
+    int32_t primary();
+    int32_t binexpr(int ptp);
+    int32_t print_statement();
+    void var_declaration();
+    int32_t assignment_statement();
+    int32_t if_statement();
+    int32_t compound_statement();
+public:
+    vector<FrontToken> tokens;
+    vector<FrontNode> nodes;
+    vector<char> text;
+    vector<int32_t> symbols;
+
+    Frontend(const char* source, size_t length);
+    void tokenize();
+    int32_t parse();
+};
+
+Frontend::Frontend(const char* source, size_t length) : source(source), length(length), pos(0), line(1), putback('\0'), current(0) {}
+
+char Frontend::next() {
+    if (putback) {
+        char c = putback;
+        putback = '\0';
+        return c;
+    }
+
+    if (pos == length) {
+        return '\0';
+    }
+
+    char c = source[pos++];
+
+    if (c == '\n') {
+        line++;
+    }
+
+    return c;
+}
+
+char Frontend::skip() {
+    char c = next();
+
+    while ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\f')) {
+        c = next();
+    }
+
+    return c;
+}
+
+// The whole source is lexed up front into one array, the parser just walks it
+void Frontend::tokenize() {
+    do {
+        scan_token();
+    } while (tokens.back().type != FT_EOF);
+}
+
+void Frontend::scan_token() {
+    char c = skip();
+    FrontToken tok = {FT_EOF, line, 0};
+
+    switch (c) {
+        case '\0':
+            break;
+        case '+':
+            tok.type = FT_Plus;
+            break;
+        case '-':
+            tok.type = FT_Minus;
+            break;
+        case '*':
+            tok.type = FT_Star;
+            break;
+        case '/':
+            tok.type = FT_Slash;
+            break;
+        case ';':
+            tok.type = FT_Semi;
+            break;
+        case '{':
+            tok.type = FT_LBrace;
+            break;
+        case '}':
+            tok.type = FT_RBrace;
+            break;
+        case '(':
+            tok.type = FT_LParen;
+            break;
+        case ')':
+            tok.type = FT_RParen;
+            break;
+        case '=':
+            if ((c = next()) == '=') {
+                tok.type = FT_Equal;
+            } else {
+                putback = c;
+                tok.type = FT_Assign;
+            }
+
+            break;
+        case '!':
+            if ((c = next()) == '=') {
+                tok.type = FT_NotEqual;
+            } else {
+                fail("Unrecognized character:" + string(1, c) + " on line " + to_string(line));
+            }
+
+            break;
+        case '<':
+            if ((c = next()) == '=') {
+                tok.type = FT_LessEqual;
+            } else {
+                putback = c;
+                tok.type = FT_LessThan;
+            }
+
+            break;
+        case '>':
+            if ((c = next()) == '=') {
+                tok.type = FT_GreaterEqual;
+            } else {
+                putback = c;
+                tok.type = FT_GreaterThan;
+            }
+
+            break;
+        default:
+            if (isdigit(c)) {
+                tok.type = FT_IntLit;
+                tok.value = scanint(c);
+                break;
+            } else if ((isalpha(c)) || (c == '_')) {
+                tok.value = scanident(c);
+                tok.type = keyword(&text[tok.value]);
+                break;
+            }
+
+            fail("Unrecognized character " + string(1, c) + " on line " + to_string(line));
+    }
+
+    tokens.push_back(tok);
+}
+
+int32_t Frontend::scanint(char c) {
+    uint32_t val = 0;
+
+    while (isdigit(c)) {
+        val = val * 10 + (c - '0');
+        c = next();
+    }
+
+    putback = c;
+    return (int32_t)val;
+}
+
+// Each distinct name is stored once in text, tokens refer to it by offset
+int32_t Frontend::scanident(char c) {
+    string buf;
+
+    while ((isalpha(c)) || (isdigit(c)) || (c == '_')) {
+        if (buf.size() == TEXT_LEN_LIMIT - 1) {
+            fail("identifier too long on line " + to_string(line));
+        }
+
+        buf += c;
+        c = next();
+    }
+
+    putback = c;
+    auto found = names.find(buf);
+
+    if (found != names.end()) {
+        return found->second;
+    }
+
+    int32_t offset = text.size();
+    text.insert(text.end(), buf.begin(), buf.end());
+    text.push_back('\0');
+    names.emplace(buf, offset);
+    return offset;
+}
+
+int Frontend::keyword(const char* s) {
+    if (strcmp(s, "print") == 0) {
+        return FT_Print;
+    } else if (strcmp(s, "int") == 0) {
+        return FT_Int;
+    } else if (strcmp(s, "if") == 0) {
+        return FT_If;
+    } else if (strcmp(s, "else") == 0) {
+        return FT_Else;
+    }
+
+    return FT_Ident;
+}
+
+const FrontToken& Frontend::token() {
+    return tokens[current];
+}
+
+void Frontend::scan() {
+    if (tokens[current].type != FT_EOF) {
+        current++;
+    }
+}
+
+void Frontend::fail(string message) {
+    throw FrontError{message};
+}
+
+void Frontend::match(int ttype, string tstr) {
+    if (token().type == ttype) {
+        scan();
+    } else {
+        fail(tstr + " expected on line " + to_string(token().line));
+    }
+}
+
+int32_t Frontend::add_node(int op, int32_t left, int32_t mid, int32_t right, int32_t value) {
+    nodes.push_back({op, left, mid, right, value, token().line});
+    return nodes.size() - 1;
+}
+
+int Frontend::op_precedence(int tok) {
+    switch (tok) {
+        case FT_Plus:
+        case FT_Minus:
+            return 10;
+        case FT_Star:
+        case FT_Slash:
+            return 20;
+        case FT_Equal:
+        case FT_NotEqual:
+            return 30;
+        case FT_LessThan:
+        case FT_GreaterThan:
+        case FT_LessEqual:
+        case FT_GreaterEqual:
+            return 40;
+        default:
+            fail("Syntax error, token:" + to_string(tok) + " on line " + to_string(token().line));
+            return 0;
+    }
+}
+
+int32_t Frontend::primary() {
+    int32_t node;
+
+    switch (token().type) {
+        case FT_IntLit:
+            node = add_node(FA_IntLit, -1, -1, -1, token().value);
+            break;
+        case FT_Ident: {
+            auto found = symbolOf.find(token().value);
+
+            if (found == symbolOf.end()) {
+                fail("Unknown variable:" + string(&text[token().value]) + " on line " + to_string(token().line));
+            }
+
+            node = add_node(FA_Ident, -1, -1, -1, found->second);
+            break;
+        }
+        default:
+            fail("Syntax error, token:" + to_string(token().type) + " on line " + to_string(token().line));
+            return -1;
+    }
+
+    scan();
+    return node;
+}
+
+int32_t Frontend::binexpr(int ptp) {
+    int32_t left = primary();
+    int tokenType = token().type;
+
+    if ((tokenType == FT_Semi) || (tokenType == FT_RParen)) {
+        return left;
+    }
+
+    while (op_precedence(tokenType) > ptp) {
+        scan();
+        int32_t right = binexpr(op_precedence(tokenType));
+        // Operators and their node ops are in the same order, one place apart
+        left = add_node(tokenType - FT_Plus + FA_Add, left, -1, right, 0);
+        tokenType = token().type;
+
+        if ((tokenType == FT_Semi) || (tokenType == FT_RParen)) {
+            return left;
+        }
+    }
+
+    return left;
+}
+
+int32_t Frontend::print_statement() {
+    match(FT_Print, "print");
+    int32_t tree = binexpr(0);
+    tree = add_node(FA_Print, tree, -1, -1, 0);
+    match(FT_Semi, ";");
+    return tree;
+}
+
+// Redeclaring a name makes it refer to a new variable from then on
+void Frontend::var_declaration() {
+    match(FT_Int, "int");
+    int32_t name = token().value;
+    match(FT_Ident, "identifier");
+    symbolOf[name] = symbols.size();
+    symbols.push_back(name);
+    match(FT_Semi, ";");
+}
+
+int32_t Frontend::assignment_statement() {
+    int32_t name = token().value;
+    match(FT_Ident, "identifier");
+    auto found = symbolOf.find(name);
+
+    if (found == symbolOf.end()) {
+        fail("Undeclared variable:" + string(&text[name]) + " on line " + to_string(token().line));
+    }
+
+    int32_t right = add_node(FA_LVIdent, -1, -1, -1, found->second);
+    match(FT_Assign, "=");
+    int32_t left = binexpr(0);
+    int32_t tree = add_node(FA_Assign, left, -1, right, 0);
+    match(FT_Semi, ";");
+    return tree;
+}
+
+int32_t Frontend::if_statement() {
+    match(FT_If, "if");
+    match(FT_LParen, "(");
+    int32_t condAST = binexpr(0);
+
+    if ((nodes[condAST].op < FA_Equal) || (nodes[condAST].op > FA_GreaterEqual)) {
+        fail("Bad comparison operator on line " + to_string(token().line));
+    }
+
+    match(FT_RParen, ")");
+    int32_t trueAST = compound_statement();
+    int32_t falseAST = -1;
+
+    if (token().type == FT_Else) {
+        scan();
+        falseAST = compound_statement();
+    }
+
+    return add_node(FA_If, condAST, trueAST, falseAST, 0);
+}
+
+// Statements are glued together left to right, -1 for an empty block
+int32_t Frontend::compound_statement() {
+    int32_t left = -1;
+    match(FT_LBrace, "{");
+
+    while (true) {
+        int32_t tree = -1;
+
+        switch (token().type) {
+            case FT_Print:
+                tree = print_statement();
+                break;
+            case FT_Int:
+                var_declaration();
+                break;
+            case FT_Ident:
+                tree = assignment_statement();
+                break;
+            case FT_If:
+                tree = if_statement();
+                break;
+            case FT_RBrace:
+                match(FT_RBrace, "}");
+                return left;
+            default:
+                fail("Syntax error, token:" + to_string(token().type) + " on line " + to_string(token().line));
+        }
+
+        if (tree != -1) {
+            left = (left == -1) ? tree : add_node(FA_Glue, left, -1, tree, 0);
+        }
+    }
+}
+
+int32_t Frontend::parse() {
+    tokenize();
+    return compound_statement();
+}
+
+// The result and the arrays it points to are freed together
+struct FrontParse : FrontResult {
+    Frontend frontend;
+    string message;
+
+    FrontParse(const char* source, size_t length) : FrontResult(), frontend(source, length) {}
+};
+
+extern "C" FrontResult* front_parse(const char* source, size_t length) {
+    FrontParse* parsed = new FrontParse(source, length);
+    Frontend& frontend = parsed->frontend;
+    parsed->root = -1;
+
+    try {
+        parsed->root = frontend.parse();
+    } catch (const FrontError& err) {
+        parsed->message = err.message;
+        parsed->error = &parsed->message[0];
+    } catch (const exception& err) {
+        // Nothing may unwind into the caller, which isn't C++
+        parsed->message = string("Internal front end error: ") + err.what();
+        parsed->error = &parsed->message[0];
+    } catch (...) {
+        parsed->message = "Internal front end error";
+        parsed->error = &parsed->message[0];
+    }
+
+    parsed->tokens = frontend.tokens.data();
+    parsed->tokenCount = frontend.tokens.size();
+    parsed->nodes = frontend.nodes.data();
+    parsed->nodeCount = frontend.nodes.size();
+    parsed->text = frontend.text.data();
+    parsed->textLength = frontend.text.size();
+    parsed->symbols = frontend.symbols.data();
+    parsed->symbolCount = frontend.symbols.size();
+    return parsed;
+}
+
+extern "C" void front_free(FrontResult* result) {
+    delete static_cast<FrontParse*>(result);
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// A native lexer and parser for the Python port's grammar, with a flat C interface that
+// python/frontend.py loads through ctypes. Everything it returns is a plain array of
+// fixed-size records, so Python can read it in place without copying.
+
+// Numbered as in python/tokentype.py
+enum FrontTokenType {
+    FT_EOF,
+    FT_Plus, FT_Minus,
+    FT_Star, FT_Slash,
+    FT_Equal, FT_NotEqual,
+    FT_LessThan, FT_GreaterThan, FT_LessEqual, FT_GreaterEqual,
+    FT_IntLit, FT_Semi, FT_Assign, FT_Ident,
+    FT_LBrace, FT_RBrace, FT_LParen, FT_RParen,
+    // Keywords
+    FT_Print, FT_Int, FT_If, FT_Else
+};
+
+// Numbered as in python/astnodeop.py
+enum FrontNodeOp {
+    FA_Add, FA_Subtract, FA_Multiply, FA_Divide,
+    FA_Equal, FA_NotEqual, FA_LessThan, FA_GreaterThan, FA_LessEqual, FA_GreaterEqual,
+    FA_IntLit, FA_Ident, FA_LVIdent, FA_Assign,
+    FA_Glue, FA_If, FA_Print
+};
+
+extern "C" {
+
+struct FrontToken {
+    int32_t type;           // FrontTokenType
+    int32_t line;
+    int32_t value;          // Literal value, or where an identifier's name starts in text
+};
+
+struct FrontNode {
+    int32_t op;             // FrontNodeOp
+    int32_t left;           // Child node indices, -1 where there isn't one
+    int32_t mid;
+    int32_t right;
+    int32_t value;          // Literal value, or the symbol an Ident or LVIdent refers to
+    int32_t line;
+};
+
+struct FrontResult {
+    FrontToken* tokens;
+    int32_t tokenCount;
+    FrontNode* nodes;
+    int32_t nodeCount;
+    int32_t root;           // The program's compound statement, -1 if it's empty
+    char* text;             // Identifier names, each ending in a NUL
+    int32_t textLength;
+    int32_t* symbols;       // Where each variable's name starts in text, in declaration order
+    int32_t symbolCount;
+    char* error;            // The first error, null if parsing succeeded
+};
+
+// The result stays valid until it's passed to front_free
+FrontResult* front_parse(const char* source, size_t length);
+void front_free(FrontResult* result);
+
+}
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/CallingConv.h>
+#include <llvm/IR/Instructions.h>
+using namespace std;
+using namespace llvm;
+
+// Every function is only called by the program's own code, so none of them need the C calling convention
+void set_function_attributes(Function* fn) {
+    fn->setCallingConv(CallingConv::Fast);
+    fn->addFnAttr(Attribute::NoUnwind);
+}
+
+// A function taking ints and pointers, restrict-qualified pointers as noalias
+Function* Compiler::declare_function(string name, vector<Pointer> params, Module* mod) {
+    Type* int_type = Type::getInt32Ty(mod->getContext());
+    vector<Type*> param_types;
+
+    for (Pointer param : params) {
+        param_types.push_back((param == P_None) ? int_type : int_type->getPointerTo());
+    }
+
+    FunctionType* fn_type = FunctionType::get(int_type, param_types, false);
+    Function* fn = Function::Create(fn_type, options.streamBatch ? Function::ExternalLinkage : Function::InternalLinkage, name, mod);
+    set_function_attributes(fn);
+
+    for (size_t i = 0; i < params.size(); i++) {
+        if (params[i] == P_Restrict) {
+            fn->addParamAttr(i, Attribute::NoAlias);
+        }
+    }
+
+    return fn;
+}
+
+// int name(int a, int* restrict b) { ... }, the body only sees its parameters and its own variables
+void Compiler::function_definition(string name, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    if (user_function) {
+        cerr << "Function " << name << " defined inside a function on line " << line << endl;
+        exit(1);
+    }
+
+    if (parallel_body) {
+        cerr << "Function " << name << " defined inside a parallel for on line " << line << endl;
+        exit(1);
+    }
+
+    lparen();
+    vector<string> params;
+    vector<Pointer> kinds;
+
+    while (token.type != TokenType::T_RParen) {
+        match(T_Int, "int");
+        kinds.push_back(declarator());
+        ident();
+        params.push_back(text);
+
+        if (token.type != TokenType::T_RParen) {
+            match(T_Comma, ",");
+        }
+    }
+
+    rparen();
+    sawDeclaration = true;
+    stats.symbols++;
+
+    // Streamed batches call functions defined in earlier objects, anything else stays internal for the inliner
+    Module* mod = options.streamBatch ? batch_module : module.get();
+    Function* fn = declare_function(name, kinds, mod);
+
+    if (options.streamBatch) {
+        fn->setVisibility(GlobalValue::HiddenVisibility);
+        signatures[name] = kinds;
+    }
+
+    // Defined before the body is parsed, so it can call itself
+    functions[name] = fn;
+
+    if (options.incremental) {
+        declared[name] = curStmt;
+    }
+
+    map<string, Value*> outerGlobals;
+    map<string, unsigned> outerLengths;
+    map<string, Pointer> outerPointers;
+    map<string, size_t> outerDeclared;
+    MapVector<Value*, MDNode*> outerScopes;
+    vector<BasicBlock*> outerBreaks;
+    swap(globals, outerGlobals);
+    swap(lengths, outerLengths);
+    swap(pointers, outerPointers);
+    swap(declared, outerDeclared);
+    swap(scopes, outerScopes);
+    swap(breaks, outerBreaks);
+    size_t outerVisible = visibleDecls;
+    visibleDecls = SIZE_MAX;
+    user_function = fn;
+
+    debug_function(fn, tokenLine);
+    IRBuilder<> builder(BasicBlock::Create(*context, "entry", fn));
+    Function::arg_iterator arg = fn->arg_begin();
+
+    // noalias on the argument already says what restrict does, so in the body it's an ordinary pointer
+    for (size_t i = 0; i < params.size(); i++) {
+        addglobal(params[i], 0, (kinds[i] == P_None) ? P_None : P_Plain, &builder, context);
+        builder.CreateStore(&*arg++, globals.at(params[i]));
+    }
+
+    compound_statement(&builder, printf_type, printf_fn, context);
+
+    // Falling off the end returns 0, and the block left after a final return is dropped
+    BasicBlock* last = builder.GetInsertBlock();
+
+    if ((last != &fn->getEntryBlock()) && (last->empty()) && (pred_empty(last))) {
+        last->eraseFromParent();
+    } else {
+        builder.CreateRet(builder.getInt32(0));
+    }
+
+    verify(fn);
+    user_function = nullptr;
+    visibleDecls = outerVisible;
+    swap(globals, outerGlobals);
+    swap(lengths, outerLengths);
+    swap(pointers, outerPointers);
+    swap(declared, outerDeclared);
+    swap(scopes, outerScopes);
+    swap(breaks, outerBreaks);
+}
+
+void Compiler::return_statement(IRBuilder<>* builder, LLVMContext* context) {
+    match(T_Return, "return");
+
+    if (parallel_body) {
+        cerr << "return inside a parallel for on line " << line << endl;
+        exit(1);
+    }
+
+    if (!user_function) {
+        cerr << "return outside a function on line " << line << endl;
+        exit(1);
+    }
+
+    ASTNode* tree = binexpr(0);
+    bool recursive = (tree->op == ASTNodeOp::A_Call) && (get<Value*>(tree->value) == user_function);
+    timer.enter(Ph_IRGen);
+    Value* result = int_operand(buildAST(tree, builder, context));
+
+    // A pointer argument could point into this frame, which a tail call would free before the callee reads it
+    for (Argument& arg : user_function->args()) {
+        if (arg.getType()->isPointerTy()) {
+            recursive = false;
+        }
+    }
+
+    // Returning a call to itself reuses the frame, so recursion runs in constant stack space
+    if (recursive) {
+        cast<CallInst>(result)->setTailCallKind(CallInst::TCK_MustTail);
+    }
+
+    builder->CreateRet(result);
+
+    // Anything after the return is unreachable, but still needs a block to go in
+    builder->SetInsertPoint(new_block("return.after", builder->GetInsertBlock()));
+    timer.leave();
+    release(tree);
+    semi();
+}
+
+// (a, b) as a chain of A_Arg nodes
+ASTNode* Compiler::arguments(size_t* count) {
+    lparen();
+    ASTNode* args = nullptr;
+    ASTNode** tail = &args;
+    *count = 0;
+
+    while (token.type != TokenType::T_RParen) {
+        *tail = new ASTNode(ASTNodeOp::A_Arg, binexpr(0), nullptr, 0);
+        tail = &(*tail)->right;
+        (*count)++;
+
+        if (token.type != TokenType::T_RParen) {
+            match(T_Comma, ",");
+        }
+    }
+
+    rparen();
+    return args;
+}
+
+// name(a, b) once the name is read
+ASTNode* Compiler::call(Function* fn) {
+    size_t count;
+    ASTNode* args = arguments(&count);
+
+    if (count != fn->arg_size()) {
+        cerr << "Function " << fn->getName().str() << " takes " << fn->arg_size() << " arguments, " << count << " given on line " << line << endl;
+        exit(1);
+    }
+
+    // The function can store through any pointer it's given
+    for (Argument& param : fn->args()) {
+        if (param.getType()->isPointerTy()) {
+            stored(nullptr);
+            break;
+        }
+    }
+
+    return new ASTNode(ASTNodeOp::A_Call, args, nullptr, fn);
+}
+
+Function* Compiler::findfunction(string name) {
+    // Declare a function from an earlier batch the first time this batch calls it
+    if ((options.streamBatch) && (!functions.count(name)) && (signatures.count(name))) {
+        Function* fn = declare_function(name, signatures.at(name), batch_module);
+        fn->setVisibility(GlobalValue::HiddenVisibility);
+        functions[name] = fn;
+    }
+
+    auto found = functions.find(name);
+
+    if (found == functions.end()) {
+        return nullptr;
+    }
+
+    // When re-parsing part of the program, only functions defined before it can be called
+    if ((options.incremental) && (!user_function) && (declared.count(name)) && (declared.at(name) >= visibleDecls)) {
+        return nullptr;
+    }
+
+    return found->second;
+}
+
+Value* Compiler::build_call(ASTNode* node, IRBuilder<>* builder, LLVMContext* context) {
+    Function* fn = cast<Function>(get<Value*>(node->value));
+    vector<Value*> args;
+    ASTNode* arg = node->left;
+
+    while (arg) {
+        args.push_back(buildAST(arg->left, builder, context));
+
+        if (args.back()->getType() != fn->getArg(args.size() - 1)->getType()) {
+            cerr << "Argument " << args.size() << " of " << fn->getName().str() << " has the wrong type on line " << line << endl;
+            exit(1);
+        }
+
+        release(arg->left);
+        ASTNode* next = arg->right;
+        delete arg;
+        arg = next;
+    }
+
+    CallInst* inst = builder->CreateCall(fn->getFunctionType(), fn, args);
+    inst->setCallingConv(fn->getCallingConv());
+    return inst;
+}
\ No newline at end of file
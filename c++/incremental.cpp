@@ -0,0 +1,297 @@
+#include "compiler.hpp"
+#include "statement.hpp"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/TimeProfiler.h>
+using namespace std;
+using namespace llvm;
+
+const size_t DIFF_CHUNK = 4096;
+
+// Length of the common prefix of a and b, comparing whole chunks with memcmp first
+size_t common_prefix(const string& a, const string& b, size_t limit) {
+    size_t n = 0;
+
+    while ((n + DIFF_CHUNK <= limit) && (memcmp(a.data() + n, b.data() + n, DIFF_CHUNK) == 0)) {
+        n += DIFF_CHUNK;
+    }
+
+    while ((n < limit) && (a[n] == b[n])) {
+        n++;
+    }
+
+    return n;
+}
+
+// Length of the common suffix of a and b, up to limit bytes
+size_t common_suffix(const string& a, const string& b, size_t limit) {
+    size_t n = 0;
+
+    while ((n + DIFF_CHUNK <= limit) && (memcmp(a.data() + a.size() - n - DIFF_CHUNK, b.data() + b.size() - n - DIFF_CHUNK, DIFF_CHUNK) == 0)) {
+        n += DIFF_CHUNK;
+    }
+
+    while ((n < limit) && (a[a.size() - 1 - n] == b[b.size() - 1 - n])) {
+        n++;
+    }
+
+    return n;
+}
+
+vector<Statement> Compiler::incremental_statements(IRBuilder<>* builder, size_t first, size_t stop, long delta, size_t* reused) {
+    PhaseScope phase(timer, Ph_Parse);
+    TimeTraceScope trace("Parse");
+
+    vector<Statement> fresh;
+    BasicBlock* anchor = (first < stmts.size()) ? stmts[first].entry : exit_bb;
+    *reused = stmts.size();
+    curStmt = first;
+
+    while (token.type != TokenType::T_EOF) {
+        Statement stmt(lastEnd);
+        stmt.entry = BasicBlock::Create(*context, "stmt", main_function, anchor);
+        builder->SetInsertPoint(stmt.entry);
+        sawDeclaration = false;
+        single_statement(builder, printf_type, printf_func, context.get());
+        stmt.declaration = sawDeclaration;
+        stmt.end = lastEnd;
+        stmt.line = lastLine;
+        stmt.exit = builder->GetInsertBlock();
+        fresh.push_back(stmt);
+        curStmt++;
+
+        // Once past the edit, stop at the first statement boundary the old build shares
+        if (fresh.back().end >= stop) {
+            size_t oldEnd = fresh.back().end - delta;
+            auto it = lower_bound(stmts.begin() + first, stmts.end(), oldEnd, [](const Statement& s, size_t end) {
+                return s.end < end;
+            });
+
+            if ((it != stmts.end()) && (it->end == oldEnd)) {
+                *reused = (it - stmts.begin()) + 1;
+                break;
+            }
+        }
+    }
+
+    return fresh;
+}
+
+void Compiler::link_statements(BasicBlock* from, vector<Statement>::iterator first, vector<Statement>::iterator last, BasicBlock* to) {
+    IRBuilder<> builder(from);
+
+    for (auto it = first; it != last; it++) {
+        builder.CreateBr(it->entry);
+        builder.SetInsertPoint(it->exit);
+    }
+
+    builder.CreateBr(to);
+}
+
+void Compiler::erase_statements(vector<Statement>::iterator first, vector<Statement>::iterator last) {
+    if (first == last) {
+        return;
+    }
+
+    // Statements own a contiguous run of blocks, ending where the next statement starts
+    BasicBlock* end = (last != stmts.end()) ? last->entry : exit_bb;
+
+    // Loop bodies outlined from the statements go with them
+    vector<Function*> bodies;
+
+    for (BasicBlock* bb = first->entry; bb != end; bb = bb->getNextNode()) {
+        parallel_bodies(bb, &bodies);
+    }
+
+    // Blocks branch to each other, so drop every reference before deleting any of them
+    for (BasicBlock* bb = first->entry; bb != end; bb = bb->getNextNode()) {
+        bb->dropAllReferences();
+    }
+
+    while (first->entry->getNextNode() != end) {
+        first->entry->getNextNode()->eraseFromParent();
+    }
+
+    first->entry->eraseFromParent();
+
+    for (Function* body : bodies) {
+        body->dropAllReferences();
+    }
+
+    for (Function* body : bodies) {
+        body->eraseFromParent();
+    }
+}
+
+void Compiler::rebuild() {
+    dag_reset();
+    globals.clear();
+    declared.clear();
+    lengths.clear();
+    pointers.clear();
+    functions.clear();
+    signatures.clear();
+    stmts.clear();
+    rewind(0, 1);
+    scan();
+    parse();
+}
+
+size_t Compiler::update(string newSource) {
+    if (!options.incremental) {
+        cerr << "update() needs a compiler created for incremental builds" << endl;
+        exit(1);
+    }
+
+    size_t oldLen = source.size();
+    size_t newLen = newSource.size();
+    size_t limit = min(oldLen, newLen);
+
+    // Diff the sources down to the changed byte range
+    size_t prefix = common_prefix(source, newSource, limit);
+
+    if ((prefix == oldLen) && (prefix == newLen)) {
+        return 0;
+    }
+
+    size_t suffix = common_suffix(source, newSource, limit - prefix);
+    long delta = (long)newLen - (long)oldLen;
+
+    // Restart the lexer at the end of the last statement before the edit
+    size_t first = partition_point(stmts.begin(), stmts.end(), [prefix](const Statement& s) {
+        return s.end < prefix;
+    }) - stmts.begin();
+    BasicBlock* from = (first == 0) ? &main_function->getEntryBlock() : stmts[first - 1].exit;
+    size_t at = (first == 0) ? 0 : stmts[first - 1].end;
+    int atLine = (first == 0) ? 1 : stmts[first - 1].line;
+
+    // Shared nodes may remember IR the update is about to replace
+    dag_reset();
+    source = move(newSource);
+    rewind(at, atLine);
+    scan();
+
+    IRBuilder<> builder(*context);
+    size_t reused;
+    visibleDecls = first;
+    vector<Statement> fresh = incremental_statements(&builder, first, newLen - suffix, delta, &reused);
+    visibleDecls = SIZE_MAX;
+
+    // A changed declaration can affect any later statement, so start again from scratch
+    auto isDeclaration = [](const Statement& s) {
+        return s.declaration;
+    };
+
+    if ((any_of(fresh.begin(), fresh.end(), isDeclaration)) || (any_of(stmts.begin() + first, stmts.begin() + reused, isDeclaration))) {
+        rebuild();
+        return stmts.size();
+    }
+
+    // Swap the new statements' IR in for the old
+    from->getTerminator()->eraseFromParent();
+    erase_statements(stmts.begin() + first, stmts.begin() + reused);
+    BasicBlock* to = (reused < stmts.size()) ? stmts[reused].entry : exit_bb;
+    link_statements(from, fresh.begin(), fresh.end(), to);
+
+    // Statements after the edit keep their IR but move in the source
+    int lineDelta = (reused < stmts.size()) ? fresh.back().line - stmts[reused - 1].line : 0;
+
+    if ((delta != 0) || (lineDelta != 0)) {
+        for (size_t i = reused; i < stmts.size(); i++) {
+            stmts[i].begin += delta;
+            stmts[i].end += delta;
+            stmts[i].line += lineDelta;
+        }
+    }
+
+    long countDelta = (long)fresh.size() - (long)(reused - first);
+
+    if (countDelta != 0) {
+        for (auto& decl : declared) {
+            if (decl.second >= reused) {
+                decl.second += countDelta;
+            }
+        }
+    }
+
+    // Overwrite the replaced records in place, only shuffling the vector when the count changed
+    size_t rebuilt = fresh.size();
+    size_t common = min(rebuilt, reused - first);
+    move(fresh.begin(), fresh.begin() + common, stmts.begin() + first);
+
+    if (rebuilt > common) {
+        stmts.insert(stmts.begin() + first + common, make_move_iterator(fresh.begin() + common), make_move_iterator(fresh.end()));
+    } else {
+        stmts.erase(stmts.begin() + first + common, stmts.begin() + reused);
+    }
+    return rebuilt;
+}
+
+// Whether update() gets through newSource. The front end exits on the first error, so it's tried
+// in a child process, which reports the error and leaves this one as it was
+bool Compiler::update_compiles(const string& newSource) {
+    cout.flush();
+    cerr.flush();
+    pid_t pid = fork();
+
+    // Without a child to try it in, the edit just goes ahead
+    if (pid < 0) {
+        return true;
+    }
+
+    if (pid == 0) {
+        update(newSource);
+        _exit(0);
+    }
+
+    int status;
+
+    if (waitpid(pid, &status, 0) != pid) {
+        return true;
+    }
+
+    return (WIFEXITED(status)) && (WEXITSTATUS(status) == 0);
+}
+
+void Compiler::watch() {
+    run();
+    sys::fs::file_status status;
+    sys::TimePoint<> stamp;
+
+    if (!sys::fs::status(filename, status)) {
+        stamp = status.getLastModificationTime();
+    }
+
+    while (true) {
+        this_thread::sleep_for(chrono::milliseconds(100));
+
+        if ((sys::fs::status(filename, status)) || (status.getLastModificationTime() == stamp)) {
+            continue;
+        }
+
+        stamp = status.getLastModificationTime();
+        string edited = readfile(filename);
+
+        if (!update_compiles(edited)) {
+            cerr << "Keeping the previous build of " << filename << endl;
+            continue;
+        }
+
+        size_t rebuilt = update(move(edited));
+        emit(options.output);
+        cerr << "Rebuilt " << rebuilt << " of " << stmts.size() << " statements" << endl;
+    }
+}
\ No newline at end of file
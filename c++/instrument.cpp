@@ -0,0 +1,232 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/AtomicOrdering.h>
+using namespace std;
+using namespace llvm;
+
+// --instrument-statements counts how often each basic block a statement starts in runs. A function
+// keeps its counts in locals, which the optimizer can hold in registers, and adds them to its
+// thread's 64-bit counters as it returns. A thread adds those to the program's with a relaxed atomic
+// add when it's done with a parallel for, and the main thread at exit. The program then writes a
+// profile made of a 16-byte header ("STMTPROF", version, count) and then the source line of each
+// statement followed by the count of its block, to $STMTS_PROF or stmts.prof. tools/stmtprof.cpp
+// reads it back.
+
+const char* COUNTERS_NAME = "stmt.thread_counts";
+const char* MERGE_NAME = "stmt.merge";
+const char* PROFILE_NAME = "stmts.prof";
+const uint32_t PROFILE_VERSION = 1;
+
+void Compiler::count_statement(IRBuilder<>* builder) {
+    BasicBlock* block = builder->GetInsertBlock();
+    Type* counter_type = builder->getInt64Ty();
+
+    // Statements starting in the same block run as often as each other
+    if (block != countedBlock) {
+        BasicBlock& entry = block->getParent()->getEntryBlock();
+        IRBuilder<> entry_builder(&entry, entry.getFirstInsertionPt());
+        AllocaInst* slot = entry_builder.CreateAlloca(counter_type, nullptr, "stmt.count");
+        entry_builder.CreateStore(builder->getInt64(0), slot);
+        builder->CreateStore(builder->CreateAdd(builder->CreateLoad(counter_type, slot), builder->getInt64(1)), slot);
+        counterSlots.push_back(slot);
+        countedBlock = block;
+    }
+
+    counterLines.push_back(tokenLine);
+    statementCounters.push_back(counterSlots.size() - 1);
+}
+
+// The thread's counters, declared with an unknown size until we know how many blocks there are.
+// They aren't hidden, since a hidden declaration is written out even where nothing uses it, as a
+// symbol ld won't match with thread-local storage
+GlobalVariable* thread_counters(Module* mod) {
+    GlobalVariable* counters = cast<GlobalVariable>(mod->getOrInsertGlobal(COUNTERS_NAME, ArrayType::get(Type::getInt64Ty(mod->getContext()), 0)));
+    counters->setThreadLocalMode(GlobalValue::LocalExecTLSModel);
+    return counters;
+}
+
+// Adds the thread's counts to the program's, for a worker finishing its share of a parallel for
+void Compiler::merge_counters(IRBuilder<>* builder) {
+    Module* mod = builder->GetInsertBlock()->getModule();
+    FunctionCallee merge = mod->getOrInsertFunction(MERGE_NAME, builder->getVoidTy());
+    cast<Function>(merge.getCallee())->setVisibility(GlobalValue::HiddenVisibility);
+    builder->CreateCall(merge);
+}
+
+// Adds the local counts of mod's functions to their thread's counters wherever they return
+void Compiler::flush_counters(Module* mod) {
+    Type* counter_type = Type::getInt64Ty(mod->getContext());
+    Constant* counters = thread_counters(mod);
+    MapVector<Function*, vector<unsigned>> kept;
+
+    for (unsigned at = 0; at < counterSlots.size(); at++) {
+        if ((counterSlots[at]) && (counterSlots[at]->getModule() == mod)) {
+            kept[counterSlots[at]->getFunction()].push_back(at);
+        }
+    }
+
+    for (auto& [fn, indices] : kept) {
+        for (BasicBlock& block : *fn) {
+            ReturnInst* ret = dyn_cast_or_null<ReturnInst>(block.getTerminator());
+
+            if (!ret) {
+                continue;
+            }
+
+            // A call whose result is returned stays right before the return, so it can still be a tail call
+            Instruction* before = ret;
+            CallInst* call = dyn_cast_or_null<CallInst>(ret->getPrevNode());
+
+            if ((call) && ((!ret->getReturnValue()) || (ret->getReturnValue() == call))) {
+                before = call;
+            }
+
+            IRBuilder<> builder(before);
+
+            for (unsigned at : indices) {
+                Constant* index[] = {builder.getInt32(0), builder.getInt32(at)};
+                Constant* counter = ConstantExpr::getGetElementPtr(ArrayType::get(counter_type, 0), counters, index);
+                Value* count = builder.CreateLoad(counter_type, counterSlots[at]);
+                builder.CreateAlignedStore(builder.CreateAdd(builder.CreateAlignedLoad(counter_type, counter, MaybeAlign(8)), count), counter, MaybeAlign(8));
+            }
+        }
+
+        for (unsigned at : indices) {
+            counterSlots[at] = nullptr;
+        }
+    }
+
+    // The module's blocks may be freed once it's emitted
+    countedBlock = nullptr;
+}
+
+void Compiler::finish_counters() {
+    flush_counters(module.get());
+
+    LLVMContext& ctx = *context;
+    size_t count = counterLines.size();
+    size_t blocks = counterSlots.size();
+    Type* counter_type = Type::getInt64Ty(ctx);
+    Type* line_type = Type::getInt32Ty(ctx);
+    Type* size_type = Type::getInt64Ty(ctx);
+    ArrayType* counters_type = ArrayType::get(counter_type, blocks);
+
+    // Define the thread's counters, taking over from the declaration the functions used, and the
+    // program's they're added to
+    GlobalVariable* decl = thread_counters(module.get());
+    GlobalVariable* threads = new GlobalVariable(*module, counters_type, false, GlobalValue::ExternalLinkage, ConstantAggregateZero::get(counters_type), "", decl, GlobalValue::LocalExecTLSModel);
+    decl->replaceAllUsesWith(ConstantExpr::getBitCast(threads, decl->getType()));
+    decl->eraseFromParent();
+    threads->setName(COUNTERS_NAME);
+
+    GlobalVariable* totals = cast<GlobalVariable>(module->getOrInsertGlobal("stmt.counts", counters_type));
+    totals->setLinkage(GlobalValue::InternalLinkage);
+    totals->setInitializer(ConstantAggregateZero::get(counters_type));
+
+    // stmt.merge moves the thread's counts to the program's
+    Function* merge = cast<Function>(module->getOrInsertFunction(MERGE_NAME, Type::getVoidTy(ctx)).getCallee());
+    merge->setVisibility(GlobalValue::HiddenVisibility);
+    merge->addFnAttr(Attribute::NoUnwind);
+    BasicBlock* merge_entry = BasicBlock::Create(ctx, "entry", merge);
+    BasicBlock* merge_each = BasicBlock::Create(ctx, "each", merge);
+    BasicBlock* merge_done = BasicBlock::Create(ctx, "done", merge);
+    IRBuilder<> builder(merge_entry);
+    builder.CreateCondBr(builder.getInt1(blocks > 0), merge_each, merge_done);
+
+    builder.SetInsertPoint(merge_each);
+    PHINode* block = builder.CreatePHI(size_type, 2);
+    block->addIncoming(builder.getInt64(0), merge_entry);
+    Value* own = builder.CreateInBoundsGEP(counters_type, threads, {builder.getInt64(0), block});
+    Value* total = builder.CreateInBoundsGEP(counters_type, totals, {builder.getInt64(0), block});
+    builder.CreateAtomicRMW(AtomicRMWInst::Add, total, builder.CreateAlignedLoad(counter_type, own, MaybeAlign(8)), MaybeAlign(8), AtomicOrdering::Monotonic);
+    builder.CreateAlignedStore(builder.getInt64(0), own, MaybeAlign(8));
+    Value* next_block = builder.CreateAdd(block, builder.getInt64(1));
+    block->addIncoming(next_block, merge_each);
+    builder.CreateCondBr(builder.CreateICmpULT(next_block, builder.getInt64(blocks)), merge_each, merge_done);
+
+    builder.SetInsertPoint(merge_done);
+    builder.CreateRetVoid();
+    verify(merge);
+
+    vector<Constant*> lines;
+    vector<Constant*> counters;
+
+    for (size_t at = 0; at < count; at++) {
+        lines.push_back(ConstantInt::get(line_type, counterLines[at]));
+        counters.push_back(ConstantInt::get(line_type, statementCounters[at]));
+    }
+
+    // Each statement's line, then which block's counter it reports
+    ArrayType* lines_type = ArrayType::get(line_type, count);
+    Constant* statements = ConstantStruct::getAnon({ConstantArray::get(lines_type, lines), ConstantArray::get(lines_type, counters)});
+    Type* statements_type = statements->getType();
+    GlobalVariable* statements_var = new GlobalVariable(*module, statements_type, true, GlobalValue::InternalLinkage, statements, "stmt.lines");
+
+    Constant* header_fields[] = {
+        ConstantDataArray::getString(ctx, "STMTPROF", false),
+        ConstantInt::get(line_type, PROFILE_VERSION),
+        ConstantInt::get(line_type, count)
+    };
+    Constant* header = ConstantStruct::getAnon(header_fields);
+    GlobalVariable* header_var = new GlobalVariable(*module, header->getType(), true, GlobalValue::InternalLinkage, header, "stmt.header");
+
+    // Declarations of the libc functions the dump needs
+    Type* ptr_type = Type::getInt8PtrTy(ctx);
+    FunctionCallee getenv_fn = module->getOrInsertFunction("getenv", ptr_type, ptr_type);
+    FunctionCallee fopen_fn = module->getOrInsertFunction("fopen", ptr_type, ptr_type, ptr_type);
+    FunctionCallee fwrite_fn = module->getOrInsertFunction("fwrite", size_type, ptr_type, size_type, size_type, ptr_type);
+    FunctionCallee fclose_fn = module->getOrInsertFunction("fclose", Type::getInt32Ty(ctx), ptr_type);
+    FunctionCallee atexit_fn = module->getOrInsertFunction("atexit", Type::getInt32Ty(ctx), PointerType::get(FunctionType::get(Type::getVoidTy(ctx), false), 0));
+
+    Function* dump = Function::Create(FunctionType::get(Type::getVoidTy(ctx), false), Function::InternalLinkage, "stmt.dump", module.get());
+    BasicBlock* entry = BasicBlock::Create(ctx, "entry", dump);
+    BasicBlock* write = BasicBlock::Create(ctx, "write", dump);
+    BasicBlock* each = BasicBlock::Create(ctx, "each", dump);
+    BasicBlock* written = BasicBlock::Create(ctx, "written", dump);
+    BasicBlock* done = BasicBlock::Create(ctx, "done", dump);
+    builder.SetInsertPoint(entry);
+
+    // The exiting thread's counts haven't been added yet
+    builder.CreateCall(merge);
+    Value* env = builder.CreateCall(getenv_fn, {builder.CreateGlobalStringPtr("STMTS_PROF")});
+    Value* path = builder.CreateSelect(builder.CreateIsNull(env), builder.CreateGlobalStringPtr(PROFILE_NAME), env);
+    Value* file = builder.CreateCall(fopen_fn, {path, builder.CreateGlobalStringPtr("wb")});
+    builder.CreateCondBr(builder.CreateIsNull(file), done, write);
+
+    builder.SetInsertPoint(write);
+    DataLayout layout = module->getDataLayout();
+    builder.CreateCall(fwrite_fn, {builder.CreateBitCast(header_var, ptr_type), builder.getInt64(layout.getTypeAllocSize(header->getType())), builder.getInt64(1), file});
+    builder.CreateCall(fwrite_fn, {builder.CreateBitCast(builder.CreateStructGEP(statements_type, statements_var, 0), ptr_type), builder.getInt64(4), builder.getInt64(count), file});
+    builder.CreateCondBr(builder.getInt1(count > 0), each, written);
+
+    // Each statement gets the count of the block it's in
+    builder.SetInsertPoint(each);
+    PHINode* statement = builder.CreatePHI(size_type, 2);
+    statement->addIncoming(builder.getInt64(0), write);
+    Value* index = builder.CreateLoad(line_type, builder.CreateInBoundsGEP(statements_type, statements_var, {builder.getInt64(0), builder.getInt32(1), statement}));
+    Value* counter = builder.CreateInBoundsGEP(counters_type, totals, {builder.getInt64(0), builder.CreateZExt(index, size_type)});
+    builder.CreateCall(fwrite_fn, {builder.CreateBitCast(counter, ptr_type), builder.getInt64(8), builder.getInt64(1), file});
+    Value* following = builder.CreateAdd(statement, builder.getInt64(1));
+    statement->addIncoming(following, each);
+    builder.CreateCondBr(builder.CreateICmpULT(following, builder.getInt64(count)), each, written);
+
+    builder.SetInsertPoint(written);
+    builder.CreateCall(fclose_fn, {file});
+    builder.CreateBr(done);
+
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+    verify(dump);
+
+    // Register the dump before main runs any statement
+    BasicBlock& main_entry = main_function->getEntryBlock();
+    IRBuilder<> main_builder(&main_entry, main_entry.getFirstInsertionPt());
+    debug_location(&main_builder, 0, 0);
+    main_builder.CreateCall(atexit_fn, {dump});
+}
\ No newline at end of file
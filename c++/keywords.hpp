@@ -0,0 +1,29 @@
+#pragma once
+#include "tokenType.hpp"
+#include <string>
+using namespace std;
+
+struct Keyword {
+    const char* text;
+    TokenType type;
+};
+
+// Every reserved word the scanner knows. The benchmark workloads check their made-up names against
+// this too, so a new keyword only needs adding here
+const Keyword KEYWORDS[] = {
+    {"print", T_Print}, {"int", T_Int}, {"while", T_While}, {"for", T_For}, {"return", T_Return},
+    {"if", T_If}, {"else", T_Else}, {"likely", T_Likely}, {"unlikely", T_Unlikely}, {"restrict", T_Restrict},
+    {"switch", T_Switch}, {"case", T_Case}, {"default", T_Default}, {"break", T_Break},
+    {"parallel", T_Parallel}, {"reduction", T_Reduction}
+};
+
+// The keyword's token, or T_EOF for anything else
+inline TokenType keyword_type(const string& s) {
+    for (const Keyword& k : KEYWORDS) {
+        if (s == k.text) {
+            return k.type;
+        }
+    }
+
+    return T_EOF;
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/TimeProfiler.h>
+using namespace std;
+using namespace llvm;
+
+// Where the C runtime's start files live and how ld is called to link against them, the Makefile
+// asks the host compiler
+#ifndef CRT_DIR
+#define CRT_DIR "/usr/lib/x86_64-linux-gnu/"
+#endif
+
+#ifndef GCC_LIB_DIR
+#define GCC_LIB_DIR "/usr/lib/gcc/x86_64-linux-gnu/12/"
+#endif
+
+#ifndef LINK_EMULATION
+#define LINK_EMULATION "elf_x86_64"
+#endif
+
+#ifndef DYNAMIC_LINKER
+#define DYNAMIC_LINKER "/lib64/ld-linux-x86-64.so.2"
+#endif
+
+// Object files go to memory instead of disk when they're only going to be linked
+unique_ptr<raw_pwrite_stream> Compiler::object_stream(string outName) {
+    if (!options.executable.empty()) {
+        objects.push_back(make_unique<SmallVector<char, 0>>());
+        return make_unique<raw_svector_ostream>(*objects.back());
+    }
+
+    error_code EC;
+    unique_ptr<raw_fd_ostream> file = make_unique<raw_fd_ostream>(outName, EC, sys::fs::OF_None);
+
+    if (EC) {
+        cerr << "Could not open file: " << EC.message() << endl;
+        exit(1);
+    }
+
+    return file;
+}
+
+// Linker command line for the objects at these paths, as the C compiler driver would build it
+vector<string> link_args(string outName, vector<string> inputs, bool staticLink, bool freestanding, bool sharedObject) {
+    string crt = CRT_DIR;
+    string gcc = GCC_LIB_DIR;
+    vector<string> args = {"ld", "-m", LINK_EMULATION, "-o", outName};
+
+    // run() only calls back into the host, which has libc loaded already
+    if (sharedObject) {
+        args.push_back("-shared");
+        args.insert(args.end(), inputs.begin(), inputs.end());
+        return args;
+    }
+
+    // The program brings its own _start, and there's nothing else to link
+    if (freestanding) {
+        args.insert(args.end(), {"-static", "-nostdlib"});
+        args.insert(args.end(), inputs.begin(), inputs.end());
+        return args;
+    }
+
+    // -static is the host libc.a, the minimal runtime is -ffreestanding-runtime
+    if (staticLink) {
+        args.insert(args.end(), {"-static", crt + "crt1.o", crt + "crti.o", gcc + "crtbeginT.o"});
+    } else {
+        args.insert(args.end(), {"-dynamic-linker", DYNAMIC_LINKER, crt + "crt1.o", crt + "crti.o", gcc + "crtbegin.o"});
+    }
+
+    args.insert(args.end(), {"-L" + gcc, "-L" + crt});
+    args.insert(args.end(), inputs.begin(), inputs.end());
+
+    if (staticLink) {
+        args.insert(args.end(), {"--start-group", "-lgcc", "-lgcc_eh", "-lc", "--end-group"});
+    } else {
+        args.insert(args.end(), {"-lc", "-lgcc", "--as-needed", "-lgcc_s", "--no-as-needed"});
+    }
+
+    args.insert(args.end(), {gcc + "crtend.o", crt + "crtn.o"});
+    return args;
+}
+
+// Links the objects code generation left in memory into an executable. ld still runs as its own
+// process; only the object files are kept off disk
+void Compiler::link_executable() {
+    PhaseScope phase(timer, Ph_Link);
+    TimeTraceScope trace("Link", options.executable);
+
+    // The linker reads its inputs by name, so each buffer gets an anonymous file that never touches disk
+    vector<int> fds;
+    vector<string> inputs;
+
+    for (auto& object : objects) {
+        int fd = memfd_create("output.o", 0);
+
+        if ((fd < 0) || (write(fd, object->data(), object->size()) != (ssize_t)object->size())) {
+            cerr << "Could not hand object to the linker" << endl;
+            exit(1);
+        }
+
+        fds.push_back(fd);
+        inputs.push_back("/proc/self/fd/" + to_string(fd));
+    }
+
+    vector<string> args = link_args(options.executable, inputs, options.staticLink, options.freestanding, options.sharedObject);
+
+    // ld inherits the memory files, so it finds them under /proc/self/fd like any other input
+    ErrorOr<string> ld = sys::findProgramByName("ld");
+
+    if (!ld) {
+        cerr << "No linker found, -o needs ld on the PATH" << endl;
+        exit(1);
+    }
+
+    vector<StringRef> argv(args.begin(), args.end());
+    bool linked = sys::ExecuteAndWait(*ld, argv) == 0;
+
+    for (int fd : fds) {
+        close(fd);
+    }
+
+    objects.clear();
+
+    if (!linked) {
+        cerr << "Could not link " << options.executable << endl;
+        exit(1);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "compiler.hpp"
+#include "loopHints.hpp"
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Metadata.h>
+using namespace std;
+using namespace llvm;
+
+// New blocks go right after the one given, so a statement's blocks stay in one contiguous run
+BasicBlock* Compiler::new_block(string name, BasicBlock* after) {
+    return BasicBlock::Create(after->getContext(), name, after->getParent(), after->getNextNode());
+}
+
+void Compiler::compound_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    lbrace();
+
+    while (token.type != TokenType::T_RBrace) {
+        if (!single_statement(builder, printf_type, printf_fn, context)) {
+            cerr << "} expected on line " << line << endl;
+            exit(1);
+        }
+    }
+
+    rbrace();
+}
+
+void Compiler::while_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    match(T_While, "while");
+    lparen();
+    ASTNode* cond = binexpr(0);
+    rparen();
+    loop(builder, cond, nullptr, printf_type, printf_fn, context);
+}
+
+void Compiler::for_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    match(T_For, "for");
+    lparen();
+    ASTNode* init = assignment();
+    semi();
+    ASTNode* cond = binexpr(0);
+    semi();
+    ASTNode* post = assignment();
+    rparen();
+
+    timer.enter(Ph_IRGen);
+    buildAST(init, builder, context);
+    timer.leave();
+    release(init);
+
+    loop(builder, cond, post, printf_type, printf_fn, context);
+}
+
+// Leaves the innermost loop or switch
+void Compiler::break_statement(IRBuilder<>* builder) {
+    match(T_Break, "break");
+
+    if ((breaks.empty()) && (parallel_body)) {
+        cerr << "break out of a parallel for on line " << line << endl;
+        exit(1);
+    }
+
+    if (breaks.empty()) {
+        cerr << "break outside a loop or switch on line " << line << endl;
+        exit(1);
+    }
+
+    builder->CreateBr(breaks.back());
+
+    // Anything after the break is unreachable, but still needs a block to go in
+    builder->SetInsertPoint(new_block("break.after", builder->GetInsertBlock()));
+    semi();
+}
+
+// #pragma clang loop hints apply to the loop statement that follows
+void Compiler::pragma_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    stringstream words(text);
+    string word;
+    words >> word;
+
+    if (word != "pragma") {
+        cerr << "Unknown directive #" << word << " on line " << line << endl;
+        exit(1);
+    }
+
+    string clang, kind;
+    words >> clang >> kind;
+    LoopHints parsed;
+
+    // Other pragmas don't concern us
+    if ((clang != "clang") || (kind != "loop")) {
+        scan();
+        return;
+    }
+
+    while (words >> word) {
+        size_t open = word.find('(');
+
+        if ((open == string::npos) || (word.back() != ')')) {
+            cerr << "Bad loop hint " << word << " on line " << line << endl;
+            exit(1);
+        }
+
+        string name = word.substr(0, open);
+        string value = word.substr(open + 1, word.size() - open - 2);
+        int count = 0;
+
+        if ((!value.empty()) && (value.find_first_not_of("0123456789") == string::npos)) {
+            errno = 0;
+            unsigned long parsedCount = strtoul(value.c_str(), nullptr, 10);
+
+            if ((errno == ERANGE) || (parsedCount > INT_MAX)) {
+                cerr << "Loop hint count " << value << " is too large on line " << line << endl;
+                exit(1);
+            }
+
+            count = parsedCount;
+        }
+
+        if ((name == "vectorize") && ((value == "enable") || (value == "disable"))) {
+            parsed.vectorize = (value == "enable");
+        } else if ((name == "vectorize_width") && (count > 0)) {
+            parsed.vectorizeWidth = count;
+        } else if ((name == "interleave_count") && (count > 0)) {
+            parsed.interleaveCount = count;
+        } else if ((name == "unroll") && ((value == "disable") || (value == "enable") || (value == "full"))) {
+            parsed.unroll = (value == "disable") ? 0 : (value == "enable") ? 1 : 2;
+        } else if ((name == "unroll_count") && (count > 0)) {
+            parsed.unrollCount = count;
+        } else {
+            cerr << "Bad loop hint " << word << " on line " << line << endl;
+            exit(1);
+        }
+    }
+
+    scan();
+
+    if ((token.type != TokenType::T_While) && (token.type != TokenType::T_For)) {
+        cerr << "Loop hints must come before a loop on line " << line << endl;
+        exit(1);
+    }
+
+    hints = parsed;
+    single_statement(builder, printf_type, printf_fn, context);
+}
+
+// The !llvm.loop node for the latch's branch back to the header, null if there's nothing to say
+MDNode* loop_metadata(LLVMContext* context, LoopHints hints) {
+    if (hints.empty()) {
+        return nullptr;
+    }
+
+    vector<Metadata*> ops;
+    ops.push_back(nullptr);
+    Type* int_type = Type::getInt32Ty(*context);
+
+    auto flag = [&](string name) {
+        ops.push_back(MDNode::get(*context, {MDString::get(*context, name)}));
+    };
+
+    auto value = [&](string name, Constant* c) {
+        ops.push_back(MDNode::get(*context, {MDString::get(*context, name), ConstantAsMetadata::get(c)}));
+    };
+
+    if (hints.vectorize >= 0) {
+        value("llvm.loop.vectorize.enable", ConstantInt::getBool(*context, hints.vectorize));
+    }
+
+    if (hints.vectorizeWidth > 0) {
+        value("llvm.loop.vectorize.width", ConstantInt::get(int_type, hints.vectorizeWidth));
+    }
+
+    if (hints.interleaveCount > 0) {
+        value("llvm.loop.interleave.count", ConstantInt::get(int_type, hints.interleaveCount));
+    }
+
+    if (hints.unroll == 0) {
+        flag("llvm.loop.unroll.disable");
+    } else if (hints.unroll == 1) {
+        flag("llvm.loop.unroll.enable");
+    } else if (hints.unroll == 2) {
+        flag("llvm.loop.unroll.full");
+    }
+
+    if (hints.unrollCount > 0) {
+        value("llvm.loop.unroll.count", ConstantInt::get(int_type, hints.unrollCount));
+    }
+
+    // Loop IDs refer to themselves, which also keeps them distinct
+    MDNode* node = MDNode::getDistinct(*context, ops);
+    node->replaceOperandWith(0, node);
+    return node;
+}
+
+// Lower a loop to preheader -> header -> body -> latch -> header, leaving through exit.
+// post is the for loop's increment, run in the latch
+void Compiler::loop(IRBuilder<>* builder, ASTNode* cond, ASTNode* post, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    LoopHints loopHints = hints;
+    hints = LoopHints();
+    DebugLoc at = builder->getCurrentDebugLocation();
+
+    BasicBlock* preheader = new_block("loop.preheader", builder->GetInsertBlock());
+    BasicBlock* header = new_block("loop.header", preheader);
+    BasicBlock* body = new_block("loop.body", header);
+    BasicBlock* latch = new_block("loop.latch", body);
+    BasicBlock* exit = new_block("loop.exit", latch);
+
+    builder->CreateBr(preheader);
+    builder->SetInsertPoint(preheader);
+    builder->CreateBr(header);
+
+    builder->SetInsertPoint(header);
+    timer.enter(Ph_IRGen);
+    Value* test = buildAST(cond, builder, context);
+    builder->CreateCondBr(builder->CreateIsNotNull(test), body, exit);
+    timer.leave();
+    release(cond);
+
+    // The body may add blocks of its own, which end up between it and the latch
+    builder->SetInsertPoint(body);
+    breaks.push_back(exit);
+    single_statement(builder, printf_type, printf_fn, context);
+    breaks.pop_back();
+    builder->CreateBr(latch);
+
+    builder->SetInsertPoint(latch);
+    builder->SetCurrentDebugLocation(at);
+
+    if (post) {
+        timer.enter(Ph_IRGen);
+        buildAST(post, builder, context);
+        timer.leave();
+        release(post);
+    }
+
+    BranchInst* back = builder->CreateBr(header);
+
+    if (MDNode* md = loop_metadata(context, loopHints)) {
+        back->setMetadata(LLVMContext::MD_loop, md);
+    }
+
+    builder->SetInsertPoint(exit);
+}
\ No newline at end of file
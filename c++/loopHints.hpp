@@ -0,0 +1,16 @@
+#pragma once
+
+// What a #pragma clang loop line asks of the loop after it, -1 where it says nothing
+struct LoopHints {
+    int vectorize;          // vectorize(enable) or vectorize(disable)
+    int vectorizeWidth;     // vectorize_width(N)
+    int interleaveCount;    // interleave_count(N)
+    int unroll;             // unroll(disable), unroll(enable) or unroll(full) as 0, 1 or 2
+    int unrollCount;        // unroll_count(N)
+
+    LoopHints() : vectorize(-1), vectorizeWidth(-1), interleaveCount(-1), unroll(-1), unrollCount(-1) {}
+
+    bool empty() {
+        return (vectorize < 0) && (vectorizeWidth < 0) && (interleaveCount < 0) && (unroll < 0) && (unrollCount < 0);
+    }
+};
\ No newline at end of file
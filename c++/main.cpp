@@ -1,19 +1,254 @@
 #include "compiler.hpp"
 #include <iostream>
 #include <cstdlib>
+#include <string>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/Error.h>
 using namespace std;
+using namespace llvm;
 
 void usage(char* prog) {
-    cerr << "Usage: " << prog << " infile" << endl;
+    cerr << "Usage: " << prog << " [options] infile" << endl;
+    cerr << "  --watch                       Recompile incrementally whenever infile changes" << endl;
+    cerr << "  --chunk-size=N                Outline main into functions of N statements" << endl;
+    cerr << "  --threads=N                   Generate code on N threads, into N object files" << endl;
+    cerr << "  --stream[=N]                  Emit an object file per N statements to bound memory" << endl;
+    cerr << "  -o FILE                       Link an executable with the system ld, objects passed as memfds" << endl;
+    cerr << "  -static                       Link the executable statically against libc.a" << endl;
+    cerr << "  -ffreestanding-runtime        Start and print without libc, link with ld -static alone" << endl;
+    cerr << "  -shared                       Build int run(void* ctx) for dlopen, printing through ctx" << endl;
+    cerr << "  -ftime-report                 Print time spent in each phase and LLVM pass" << endl;
+    cerr << "  -ftime-trace[=FILE]           Write a Chrome trace of the compilation" << endl;
+    cerr << "  -ftime-trace-granularity=N    Leave out trace events shorter than N microseconds" << endl;
+    cerr << "  --stats                       Print token, AST, IR and memory statistics" << endl;
+    cerr << "  --stats-json=FILE             Write the statistics to FILE as JSON" << endl;
+    cerr << "  -g                            Emit DWARF line tables for profilers and debuggers" << endl;
+    cerr << "  --instrument-statements       Count statement executions, written to stmts.prof at exit" << endl;
+    cerr << "  --dag                         Share repeated subexpressions and build each once per block" << endl;
+    cerr << "  -O0, -O1, -O2, -O3            Run LLVM's IR optimization pipeline at this level" << endl;
+    cerr << "  -fprofile-generate[=DIR]      Instrument for PGO, without -o; link the profile runtime" << endl;
+    cerr << "                                yourself: clang -fprofile-generate output.o" << endl;
+    cerr << "  -fprofile-use[=FILE]          Optimize with a merged profile (default.profdata)" << endl;
+    cerr << "  -march=CPU, -mcpu=CPU         Generate code for CPU (default native)" << endl;
+    cerr << "  -mattr=+FEATURE,-FEATURE      Enable or disable target features" << endl;
+    cerr << "  --target-clones=CPU,...       Also build for each x86-64 level, chosen at startup" << endl;
+    cerr << "  -Rpass=REGEX                  Report optimizations by passes matching REGEX" << endl;
+    cerr << "  -Rpass-missed=REGEX           Report optimizations they failed to make" << endl;
+    cerr << "  -Rpass-analysis=REGEX         Report their analyses" << endl;
     exit(1);
 }
 
+// Chrome trace goes next to the object file unless named
+string trace_name(string output) {
+    size_t dot = output.rfind('.');
+
+    if ((dot == string::npos) || (output.find('/', dot) != string::npos)) {
+        return output + ".json";
+    }
+
+    return output.substr(0, dot) + ".json";
+}
+
+// Value of a --flag=N option, which must be a positive number
+unsigned long count_arg(char* prog, string arg) {
+    string value = arg.substr(arg.find('=') + 1);
+
+    if ((value.empty()) || (value.find_first_not_of("0123456789") != string::npos) || (stoul(value) == 0)) {
+        usage(prog);
+    }
+
+    return stoul(value);
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    Options options;
+    bool watch = false;
+    char* infile = nullptr;
+    bool timeTrace = false;
+    string traceFile;
+    unsigned granularity = 500;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--watch") {
+            watch = true;
+        } else if (arg.rfind("--chunk-size=", 0) == 0) {
+            options.chunkSize = count_arg(argv[0], arg);
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            options.threads = count_arg(argv[0], arg);
+        } else if (arg == "--stream") {
+            options.streamBatch = DEFAULT_STREAM_BATCH;
+        } else if (arg.rfind("--stream=", 0) == 0) {
+            options.streamBatch = count_arg(argv[0], arg);
+        } else if (arg == "-o") {
+            if ((i + 1 == argc) || (argv[i + 1][0] == '\0')) {
+                usage(argv[0]);
+            }
+
+            options.executable = argv[++i];
+        } else if (arg == "-static") {
+            options.staticLink = true;
+        } else if (arg == "-ffreestanding-runtime") {
+            options.freestanding = true;
+        } else if (arg == "-shared") {
+            options.sharedObject = true;
+        } else if (arg == "-ftime-report") {
+            options.timeReport = true;
+        } else if (arg == "-ftime-trace") {
+            timeTrace = true;
+        } else if (arg.rfind("-ftime-trace=", 0) == 0) {
+            timeTrace = true;
+            traceFile = arg.substr(arg.find('=') + 1);
+        } else if (arg.rfind("-ftime-trace-granularity=", 0) == 0) {
+            granularity = count_arg(argv[0], arg);
+        } else if (arg == "-g") {
+            options.debugInfo = true;
+        } else if (arg == "--instrument-statements") {
+            options.instrument = true;
+        } else if (arg == "--dag") {
+            options.dag = true;
+        } else if ((arg.size() == 3) && (arg.rfind("-O", 0) == 0) && (arg[2] >= '0') && (arg[2] <= '3')) {
+            options.optLevel = arg[2] - '0';
+        } else if (arg == "-fprofile-generate") {
+            options.profileGenerate = ".";
+        } else if (arg.rfind("-fprofile-generate=", 0) == 0) {
+            options.profileGenerate = arg.substr(arg.find('=') + 1);
+
+            if (options.profileGenerate.empty()) {
+                usage(argv[0]);
+            }
+        } else if (arg == "-fprofile-use") {
+            options.profileUse = "default.profdata";
+        } else if (arg.rfind("-fprofile-use=", 0) == 0) {
+            options.profileUse = arg.substr(arg.find('=') + 1);
+
+            if (options.profileUse.empty()) {
+                usage(argv[0]);
+            }
+        } else if ((arg.rfind("-march=", 0) == 0) || (arg.rfind("-mcpu=", 0) == 0)) {
+            options.cpu = arg.substr(arg.find('=') + 1);
+        } else if (arg.rfind("-mattr=", 0) == 0) {
+            options.features = arg.substr(arg.find('=') + 1);
+        } else if (arg.rfind("--target-clones=", 0) == 0) {
+            string list = arg.substr(arg.find('=') + 1);
+            options.targetClones.clear();
+
+            for (size_t at = 0; at <= list.size();) {
+                size_t comma = min(list.find(',', at), list.size());
+                options.targetClones.push_back(list.substr(at, comma - at));
+                at = comma + 1;
+            }
+
+            if (!valid_clones(options.targetClones)) {
+                usage(argv[0]);
+            }
+        } else if (arg.rfind("-Rpass=", 0) == 0) {
+            options.remarks = arg.substr(arg.find('=') + 1);
+        } else if (arg.rfind("-Rpass-missed=", 0) == 0) {
+            options.missedRemarks = arg.substr(arg.find('=') + 1);
+        } else if (arg.rfind("-Rpass-analysis=", 0) == 0) {
+            options.analysisRemarks = arg.substr(arg.find('=') + 1);
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg.rfind("--stats-json=", 0) == 0) {
+            options.statsJson = arg.substr(arg.find('=') + 1);
+
+            if (options.statsJson.empty()) {
+                usage(argv[0]);
+            }
+        } else if ((arg[0] == '-') || (infile)) {
+            usage(argv[0]);
+        } else {
+            infile = argv[i];
+        }
+    }
+
+    if (!infile) {
         usage(argv[0]);
     }
 
-    Compiler compiler(argv[1]);
-    compiler.run();
+    if (options.cpu.empty()) {
+        cerr << "-march and -mcpu need a CPU name" << endl;
+        exit(1);
+    }
+
+    // Only executables are linked, so without -o there is nothing for -static to apply to
+    if ((options.staticLink) && (options.executable.empty())) {
+        cerr << "-static needs -o" << endl;
+        exit(1);
+    }
+
+    // The -O0 pipeline never reads a profile, so it would be silently ignored
+    if ((!options.profileUse.empty()) && (options.optLevel == 0)) {
+        cerr << "-fprofile-use needs -O1 or higher" << endl;
+        exit(1);
+    }
+
+    auto conflict = [](bool clash, string first, string second) {
+        if (clash) {
+            cerr << first << " cannot be combined with " << second << endl;
+            exit(1);
+        }
+    };
+
+    // Statements shifted by an edit would keep their old line numbers, so --watch builds go without -g or counters
+    conflict((watch) && (options.chunkSize), "--watch", "--chunk-size");
+    conflict((watch) && (options.streamBatch), "--watch", "--stream");
+    conflict((watch) && (options.debugInfo), "--watch", "-g");
+    conflict((watch) && (options.instrument), "--watch", "--instrument-statements");
+
+    conflict((options.streamBatch) && (options.threads > 1), "--stream", "--threads");
+    conflict((options.streamBatch) && (!options.targetClones.empty()), "--stream", "--target-clones");
+    conflict((options.threads > 1) && (!options.targetClones.empty()), "--threads", "--target-clones");
+    conflict((!options.profileGenerate.empty()) && (!options.profileUse.empty()), "-fprofile-generate", "-fprofile-use");
+    conflict((!options.executable.empty()) && (!options.profileGenerate.empty()), "-o", "-fprofile-generate");
+
+    conflict((options.freestanding) && (options.instrument), "-ffreestanding-runtime", "--instrument-statements");
+    conflict((options.freestanding) && (!options.profileGenerate.empty()), "-ffreestanding-runtime", "-fprofile-generate");
+    conflict((options.freestanding) && (!options.targetClones.empty()), "-ffreestanding-runtime", "--target-clones");
+
+    // Calls to run() can overlap, so the program's variables stay on its stack rather than in the globals
+    // outlined code shares, and nothing may rely on a process of its own
+    conflict((options.sharedObject) && (options.chunkSize), "-shared", "--chunk-size");
+    conflict((options.sharedObject) && (options.threads > 1), "-shared", "--threads");
+    conflict((options.sharedObject) && (options.streamBatch), "-shared", "--stream");
+    conflict((options.sharedObject) && (options.instrument), "-shared", "--instrument-statements");
+    conflict((options.sharedObject) && (options.freestanding), "-shared", "-ffreestanding-runtime");
+    conflict((options.sharedObject) && (options.staticLink), "-shared", "-static");
+    conflict((options.sharedObject) && (!options.targetClones.empty()), "-shared", "--target-clones");
+
+    // Parallel and streamed code generation need more than one function to hand out
+    if (((options.threads > 1) || (options.streamBatch)) && (!watch) && (!options.chunkSize)) {
+        options.chunkSize = DEFAULT_CHUNK_SIZE;
+    }
+
+    options.incremental = watch;
+
+    if (timeTrace) {
+        timeTraceProfilerInitialize(granularity, argv[0]);
+    }
+
+    Compiler compiler(infile, options);
+
+    if (watch) {
+        compiler.watch();
+    } else {
+        compiler.run();
+    }
+
+    if (timeTrace) {
+        if (traceFile.empty()) {
+            traceFile = trace_name(options.output);
+        }
+
+        if (Error err = timeTraceProfilerWrite(traceFile, options.output)) {
+            cerr << "Could not write time trace: " << toString(move(err)) << endl;
+            exit(1);
+        }
+
+        timeTraceProfilerCleanup();
+    }
+
     return 0;
 }
\ No newline at end of file
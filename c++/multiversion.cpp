@@ -0,0 +1,225 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalIFunc.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+using namespace std;
+using namespace llvm;
+
+// CPUID bits each x86-64 micro-architecture level needs, on top of the level below it
+struct LevelRequirements {
+    const char* cpu;
+    uint32_t leaf1ecx;      // CPUID 1, ECX
+    uint32_t leaf7ebx;      // CPUID 7, EBX
+    uint32_t extecx;        // CPUID 0x80000001, ECX
+    uint32_t xcr0;          // Register state the OS must save, from XGETBV
+};
+
+// Ordered from the baseline up, so requirements accumulate
+const LevelRequirements levels[] = {
+    {"x86-64", 0, 0, 0, 0},
+    // SSE3, SSSE3, CMPXCHG16B, SSE4.1, SSE4.2, POPCNT / LAHF
+    {"x86-64-v2", (1u << 0) | (1u << 9) | (1u << 13) | (1u << 19) | (1u << 20) | (1u << 23), 0, (1u << 0), 0},
+    // FMA, MOVBE, OSXSAVE, AVX, F16C / BMI1, AVX2, BMI2 / LZCNT / XMM and YMM state
+    {"x86-64-v3", (1u << 12) | (1u << 22) | (1u << 27) | (1u << 28) | (1u << 29), (1u << 3) | (1u << 5) | (1u << 8), (1u << 5), 0x6},
+    // AVX512F, AVX512DQ, AVX512CD, AVX512BW, AVX512VL / opmask and ZMM state
+    {"x86-64-v4", 0, (1u << 16) | (1u << 17) | (1u << 28) | (1u << 30) | (1u << 31), 0, 0xe0},
+};
+
+const size_t LEVEL_COUNT = sizeof(levels) / sizeof(levels[0]);
+
+int level_index(string cpu) {
+    for (size_t i = 0; i < LEVEL_COUNT; i++) {
+        if (cpu == levels[i].cpu) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Checked by main before any code is generated
+bool valid_clones(vector<string> cpus) {
+    for (string& cpu : cpus) {
+        if (level_index(cpu) < 0) {
+            return false;
+        }
+    }
+
+    return !cpus.empty();
+}
+
+// Registers {eax, ebx, ecx, edx} after CPUID with the given leaf
+Value* cpuid(IRBuilder<>* builder, uint32_t leaf) {
+    Type* int_type = builder->getInt32Ty();
+    StructType* regs = StructType::get(int_type, int_type, int_type, int_type);
+    FunctionType* fn_type = FunctionType::get(regs, {int_type, int_type}, false);
+    InlineAsm* asm_fn = InlineAsm::get(fn_type, "cpuid", "={ax},={bx},={cx},={dx},{ax},{cx}", false);
+    return builder->CreateCall(fn_type, asm_fn, {builder->getInt32(leaf), builder->getInt32(0)});
+}
+
+// True when every bit of mask is set in value
+Value* has_bits(IRBuilder<>* builder, Value* value, uint32_t mask) {
+    return builder->CreateICmpEQ(builder->CreateAnd(value, mask), builder->getInt32(mask));
+}
+
+// Builds the program once per CPU in --target-clones and makes main dispatch to the best one the machine
+// running it supports, through an ifunc resolved once at load time
+void Compiler::multiversion(Module* mod) {
+    if (options.targetClones.empty()) {
+        return;
+    }
+
+    if (Triple(mod->getTargetTriple()).getArch() != Triple::x86_64) {
+        cerr << "Target clones are only supported on x86-64" << endl;
+        exit(1);
+    }
+
+    LLVMContext& ctx = mod->getContext();
+
+    // The baseline always goes in, so there's a version for every machine
+    vector<bool> wanted(LEVEL_COUNT, false);
+    wanted[0] = true;
+
+    for (string& cpu : options.targetClones) {
+        wanted[level_index(cpu)] = true;
+    }
+
+    vector<Function*> originals;
+
+    for (Function& fn : *mod) {
+        if (!fn.isDeclaration()) {
+            originals.push_back(&fn);
+        }
+    }
+
+    Function* main_fn = mod->getFunction("main");
+    vector<Function*> versions(LEVEL_COUNT, nullptr);
+
+    for (size_t level = 0; level < LEVEL_COUNT; level++) {
+        if (!wanted[level]) {
+            continue;
+        }
+
+        // Declare every function's clone first, so calls between them can be remapped to the same version
+        ValueToValueMapTy vmap;
+        vector<Function*> clones;
+
+        for (Function* fn : originals) {
+            Function* clone = Function::Create(fn->getFunctionType(), Function::InternalLinkage, fn->getName() + "." + levels[level].cpu, mod);
+            vmap[fn] = clone;
+            clones.push_back(clone);
+        }
+
+        for (size_t i = 0; i < originals.size(); i++) {
+            Function::arg_iterator dest = clones[i]->arg_begin();
+
+            for (Argument& arg : originals[i]->args()) {
+                vmap[&arg] = &*dest++;
+            }
+
+            SmallVector<ReturnInst*, 4> returns;
+            CloneFunctionInto(clones[i], originals[i], vmap, CloneFunctionChangeType::LocalChangesOnly, returns);
+
+            // Cloning copies the original's attributes, so the version's own go on afterwards
+            clones[i]->setLinkage(Function::InternalLinkage);
+            clones[i]->setVisibility(GlobalValue::DefaultVisibility);
+            clones[i]->setDSOLocal(true);
+            clones[i]->addFnAttr("target-cpu", levels[level].cpu);
+            clones[i]->addFnAttr("target-features", "");
+        }
+
+        versions[level] = cast<Function>(vmap[main_fn]);
+    }
+
+    // Pick the most capable version whose requirements the running CPU meets
+    PointerType* main_ptr = main_fn->getFunctionType()->getPointerTo();
+    Function* resolver = Function::Create(FunctionType::get(main_ptr, false), Function::InternalLinkage, "main.resolver", mod);
+    BasicBlock* entry = BasicBlock::Create(ctx, "entry", resolver);
+
+    // The resolver and main run on every machine, so they're built for the baseline whatever -march says
+    for (Function* fn : {resolver, main_fn}) {
+        fn->addFnAttr("target-cpu", levels[0].cpu);
+        fn->addFnAttr("target-features", "");
+    }
+
+    BasicBlock* xsave = BasicBlock::Create(ctx, "xsave", resolver);
+    BasicBlock* select = BasicBlock::Create(ctx, "select", resolver);
+    IRBuilder<> builder(entry);
+
+    Value* max_leaf = builder.CreateExtractValue(cpuid(&builder, 0), 0);
+    Value* leaf1 = cpuid(&builder, 1);
+    Value* leaf1ecx = builder.CreateExtractValue(leaf1, 2);
+    Value* leaf7ebx = builder.CreateExtractValue(cpuid(&builder, 7), 1);
+    leaf7ebx = builder.CreateSelect(builder.CreateICmpUGE(max_leaf, builder.getInt32(7)), leaf7ebx, builder.getInt32(0));
+    Value* max_ext_leaf = builder.CreateExtractValue(cpuid(&builder, 0x80000000), 0);
+    Value* extecx = builder.CreateExtractValue(cpuid(&builder, 0x80000001), 2);
+    extecx = builder.CreateSelect(builder.CreateICmpUGE(max_ext_leaf, builder.getInt32(0x80000001)), extecx, builder.getInt32(0));
+
+    // XGETBV faults unless the OS has enabled it
+    builder.CreateCondBr(has_bits(&builder, leaf1ecx, 1u << 27), xsave, select);
+    builder.SetInsertPoint(xsave);
+    FunctionType* xgetbv_type = FunctionType::get(StructType::get(builder.getInt32Ty(), builder.getInt32Ty()), {builder.getInt32Ty()}, false);
+    InlineAsm* xgetbv = InlineAsm::get(xgetbv_type, "xgetbv", "={ax},={dx},{cx}", false);
+    Value* xcr0_value = builder.CreateExtractValue(builder.CreateCall(xgetbv_type, xgetbv, {builder.getInt32(0)}), 0);
+    builder.CreateBr(select);
+
+    builder.SetInsertPoint(select);
+    PHINode* xcr0 = builder.CreatePHI(builder.getInt32Ty(), 2);
+    xcr0->addIncoming(builder.getInt32(0), entry);
+    xcr0->addIncoming(xcr0_value, xsave);
+
+    Value* chosen = versions[0];
+    uint32_t needs1 = 0, needs7 = 0, needsExt = 0, needsXcr0 = 0;
+
+    for (size_t level = 1; level < LEVEL_COUNT; level++) {
+        needs1 |= levels[level].leaf1ecx;
+        needs7 |= levels[level].leaf7ebx;
+        needsExt |= levels[level].extecx;
+        needsXcr0 |= levels[level].xcr0;
+
+        if (!wanted[level]) {
+            continue;
+        }
+
+        Value* supported = builder.CreateAnd(has_bits(&builder, leaf1ecx, needs1), has_bits(&builder, leaf7ebx, needs7));
+        supported = builder.CreateAnd(supported, has_bits(&builder, extecx, needsExt));
+        supported = builder.CreateAnd(supported, has_bits(&builder, xcr0, needsXcr0));
+        chosen = builder.CreateSelect(supported, versions[level], chosen);
+    }
+
+    builder.CreateRet(chosen);
+
+    // main itself stays generic and jumps through the ifunc
+    GlobalIFunc* dispatch = GlobalIFunc::create(main_fn->getFunctionType(), 0, GlobalValue::InternalLinkage, "main.dispatch", resolver, mod);
+    main_fn->deleteBody();
+    main_fn->setSubprogram(nullptr);
+    builder.SetInsertPoint(BasicBlock::Create(ctx, "entry", main_fn));
+    vector<Value*> args;
+
+    for (Argument& arg : main_fn->args()) {
+        args.push_back(&arg);
+    }
+
+    CallInst* call = builder.CreateCall(main_fn->getFunctionType(), dispatch, args);
+    call->setTailCall();
+    builder.CreateRet(call);
+
+    // The originals were only reachable from main's old body
+    for (Function* fn : originals) {
+        if ((fn != main_fn) && (fn->use_empty())) {
+            fn->eraseFromParent();
+        }
+    }
+
+    verify(resolver);
+    verify(main_fn);
+}
\ No newline at end of file
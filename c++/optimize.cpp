@@ -0,0 +1,108 @@
+#include "compiler.hpp"
+#include <string>
+#include <iostream>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/LLVMContext.h>
+using namespace std;
+using namespace llvm;
+
+// Set a boolean LLVM command line option, for passes that can't be configured any other way
+void set_llvm_flag(string name, bool value) {
+    StringMap<cl::Option*>& registered = cl::getRegisteredOptions();
+
+    if (registered.count(name)) {
+        static_cast<cl::opt<bool>*>(registered[name])->setValue(value);
+    }
+}
+
+// Decides which optimization remarks get printed, by matching the name of the pass making them
+struct RemarkFilter : DiagnosticHandler {
+    string passed;
+    string missed;
+    string analysis;
+
+    RemarkFilter(string passed, string missed, string analysis) : passed(passed), missed(missed), analysis(analysis) {}
+
+    static bool matches(string pattern, StringRef pass) {
+        return (!pattern.empty()) && (Regex(pattern).match(pass));
+    }
+
+    bool isPassedOptRemarkEnabled(StringRef pass) const override {
+        return matches(passed, pass);
+    }
+
+    bool isMissedOptRemarkEnabled(StringRef pass) const override {
+        return matches(missed, pass);
+    }
+
+    bool isAnalysisRemarkEnabled(StringRef pass) const override {
+        return matches(analysis, pass);
+    }
+
+    bool isAnyRemarkEnabled() const override {
+        return (!passed.empty()) || (!missed.empty()) || (!analysis.empty());
+    }
+};
+
+// LLVM prints the remarks -Rpass and friends ask for to stderr
+void Compiler::remark_handler(LLVMContext* ctx) {
+    if ((options.remarks.empty()) && (options.missedRemarks.empty()) && (options.analysisRemarks.empty())) {
+        return;
+    }
+
+    ctx->setDiagnosticHandler(make_unique<RemarkFilter>(options.remarks, options.missedRemarks, options.analysisRemarks));
+}
+
+// Run the IR pipeline for -O and profile-guided builds, code generation follows it
+void Compiler::optimize(Module* mod) {
+    if ((options.optLevel == 0) && (options.profileGenerate.empty())) {
+        return;
+    }
+
+    PhaseScope phase(timer, Ph_Optimize);
+    TimeTraceScope trace("Optimize", mod->getName());
+    Optional<PGOOptions> pgo;
+
+    // Without libc there's no memset or memcpy for recognized loop idioms to call
+    if (options.freestanding) {
+        for (Function& fn : *mod) {
+            fn.addFnAttr("no-builtins");
+        }
+    }
+
+    if (!options.profileGenerate.empty()) {
+        // The profile runtime expands %m to a per-module signature, so objects don't overwrite each other
+        pgo = PGOOptions(options.profileGenerate + "/default_%m.profraw", "", "", PGOOptions::IRInstr);
+    } else if (!options.profileUse.empty()) {
+        pgo = PGOOptions(options.profileUse, "", "", PGOOptions::IRUse);
+
+        // Cold blocks the profile never saw go to a separate function, out of the way of the hot path
+        set_llvm_flag("hot-cold-split", true);
+    }
+
+    LoopAnalysisManager lam;
+    FunctionAnalysisManager fam;
+    CGSCCAnalysisManager cgam;
+    ModuleAnalysisManager mam;
+    PassBuilder pb(machine, PipelineTuningOptions(), pgo);
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+    OptimizationLevel levels[] = {OptimizationLevel::O0, OptimizationLevel::O1, OptimizationLevel::O2, OptimizationLevel::O3};
+    OptimizationLevel level = levels[options.optLevel];
+    ModulePassManager mpm = (options.optLevel == 0) ? pb.buildO0DefaultPipeline(level) : pb.buildPerModuleDefaultPipeline(level);
+    mpm.run(*mod, mam);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Statements per outlined function when parallel code generation picks the size
+const size_t DEFAULT_CHUNK_SIZE = 256;
+
+// Statements per object file in streaming mode
+const size_t DEFAULT_STREAM_BATCH = 16384;
+
+struct Options {
+    bool incremental;   // Keep per-statement IR around so update() can patch it
+    size_t chunkSize;   // Outline main into functions of this many statements, 0 keeps everything in main
+    unsigned threads;   // Code generation threads, each writing its own object file
+    size_t streamBatch; // Emit an object file every this many statements and free their IR, 0 to build one module
+    string output;      // Object file to write, extra partitions go next to it
+    string executable;  // Link the objects in memory into this executable instead, empty to write objects
+    bool staticLink;    // Link the executable statically against libc
+    bool freestanding;  // Start at our own _start and print with raw system calls, without libc
+    bool sharedObject;  // Build a PIC shared object exporting int run(void* ctx), printing through ctx
+    bool timeReport;    // Print how long each phase and LLVM pass took
+    bool stats;         // Print counts of tokens, nodes, instructions and memory use
+    string statsJson;   // Also write them to this file as JSON, empty for none
+    bool debugInfo;     // Emit DWARF line tables mapping instructions to statements
+    bool instrument;    // Count how often each statement runs and write the counts at exit
+    bool dag;           // Share nodes between repeated pure subexpressions and build each once per block
+    int optLevel;       // IR optimization pipeline, 0 to hand the IR straight to code generation
+    string profileGenerate; // Instrument for PGO, writing raw profiles into this directory
+    string profileUse;      // Optimize with this merged .profdata file
+    string cpu;         // CPU to generate code for, native for the host's CPU and features
+    string features;    // Extra target features, as in -mattr=+avx2,-fma
+    vector<string> targetClones; // Also build the program for each of these CPUs and pick one at startup
+    string remarks;         // Print optimizations made by passes matching this regex
+    string missedRemarks;   // ... optimizations they missed
+    string analysisRemarks; // ... and their analyses
+
+    Options() : incremental(false), chunkSize(0), threads(1), streamBatch(0), output("output.o"), executable(""), staticLink(false), freestanding(false), sharedObject(false), timeReport(false), stats(false), statsJson(""), debugInfo(false), instrument(false), dag(false), optLevel(0), profileGenerate(""), profileUse(""), cpu("native"), features("") {}
+};
\ No newline at end of file
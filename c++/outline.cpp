@@ -0,0 +1,156 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/FileSystem.h>
+using namespace std;
+using namespace llvm;
+
+string partname(string outName, unsigned part) {
+    if (part == 0) {
+        return outName;
+    }
+
+    // output.o becomes output.1.o, output.2.o, ...
+    size_t dot = outName.rfind('.');
+
+    if ((dot == string::npos) || (outName.find('/', dot) != string::npos)) {
+        return outName + "." + to_string(part);
+    }
+
+    return outName.substr(0, dot) + "." + to_string(part) + outName.substr(dot);
+}
+
+// Move up to limit statements into functions of at most chunkSize statements each
+vector<Function*> Compiler::outline(IRBuilder<>* builder, Module* mod, size_t limit, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    FunctionType* chunk_type = FunctionType::get(Type::getVoidTy(*context), false);
+    vector<Function*> funcs;
+    size_t count = 0;
+
+    while ((token.type != TokenType::T_EOF) && (count < limit)) {
+        if (count % options.chunkSize == 0) {
+            if (!funcs.empty()) {
+                builder->CreateRetVoid();
+                verify(funcs.back());
+            }
+
+            Function* chunk = Function::Create(chunk_type, Function::InternalLinkage, "main.chunk." + to_string(chunks++), mod);
+            chunk->addFnAttr(Attribute::NoInline);
+            debug_function(chunk, tokenLine);
+            builder->SetInsertPoint(BasicBlock::Create(*context, "entry", chunk));
+            funcs.push_back(chunk);
+        }
+
+        single_statement(builder, printf_type, printf_fn, context);
+        count++;
+    }
+
+    if (!funcs.empty()) {
+        builder->CreateRetVoid();
+        verify(funcs.back());
+    }
+
+    return funcs;
+}
+
+void Compiler::outlined_statements(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    // main just calls each chunk in order
+    BasicBlock* main_bb = builder->GetInsertBlock();
+    vector<Function*> funcs = outline(builder, module.get(), SIZE_MAX, printf_type, printf_fn, context);
+    builder->SetInsertPoint(main_bb);
+    debug_location(builder, 0, 0);
+
+    for (Function* chunk : funcs) {
+        builder->CreateCall(chunk->getFunctionType(), chunk);
+    }
+}
+
+void Compiler::streamed_statements(IRBuilder<>* builder, LLVMContext* context) {
+    FunctionType* chunk_type = FunctionType::get(Type::getVoidTy(*context), false);
+    unsigned batch = 0;
+
+    while (token.type != TokenType::T_EOF) {
+        // Each batch gets a context of its own, so none of its IR outlives its object file
+        LLVMContext batch_context;
+        remark_handler(&batch_context);
+        Module mod("main_module." + to_string(++batch), batch_context);
+        mod.setTargetTriple(module->getTargetTriple());
+        mod.setDataLayout(module->getDataLayout());
+        batch_module = &mod;
+        globals.clear();
+        functions.clear();
+        scopes.clear();
+        scope_domain = nullptr;
+        dag_reset();
+
+        // The batch's functions are described by a compile unit in its own object
+        unique_ptr<DIBuilder> main_dibuilder = move(dibuilder);
+        DIFile* main_difile = difile;
+
+        if (options.debugInfo) {
+            debug_module(&mod);
+        }
+
+        Function* batch_printf = declare_print(&mod);
+        FunctionType* batch_printf_type = batch_printf->getFunctionType();
+
+        IRBuilder<> batch_builder(batch_context);
+        vector<Function*> funcs = outline(&batch_builder, &mod, options.streamBatch, batch_printf_type, batch_printf, &batch_context);
+
+        // main calls into the batch's object by name
+        for (Function* chunk : funcs) {
+            chunk->setLinkage(Function::ExternalLinkage);
+            chunk->setVisibility(GlobalValue::HiddenVisibility);
+            Function* decl = Function::Create(chunk_type, Function::ExternalLinkage, chunk->getName(), module.get());
+            decl->setVisibility(GlobalValue::HiddenVisibility);
+            builder->CreateCall(chunk_type, decl);
+        }
+
+        if (options.instrument) {
+            flush_counters(&mod);
+        }
+
+        debug_finish();
+        dibuilder = move(main_dibuilder);
+        difile = main_difile;
+        emit_module(&mod, partname(options.output, batch));
+        globals.clear();
+        scopes.clear();
+        scope_domain = nullptr;
+        batch_module = nullptr;
+    }
+}
+
+void Compiler::emit_parallel(Module* mod, string outName) {
+    optimize(mod);
+    PhaseScope phase(timer, Ph_CodeGen);
+    TimeTraceScope trace("CodeGen", outName);
+
+    // One object file per thread, the partitions link back into the whole program
+    vector<unique_ptr<raw_pwrite_stream>> files;
+    vector<raw_pwrite_stream*> streams;
+
+    for (unsigned i = 0; i < options.threads; i++) {
+        files.push_back(object_stream(partname(outName, i)));
+        streams.push_back(files.back().get());
+    }
+
+    stats.instructions += mod->getInstructionCount();
+    splitCodeGen(*mod, streams, {}, [this]() {
+        return unique_ptr<TargetMachine>(create_machine());
+    }, CGFT_ObjectFile);
+
+    for (auto& file : files) {
+        file->flush();
+        stats.objects++;
+        stats.objectBytes += file->tell();
+    }
+}
\ No newline at end of file
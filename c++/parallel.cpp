@@ -0,0 +1,356 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/ADT/SetVector.h>
+#include <llvm/Support/AtomicOrdering.h>
+using namespace std;
+using namespace llvm;
+
+// parallel for (i = start; i < end; i = i + 1) body spreads the iterations over every core. The body
+// is outlined into a function running the iterations from begin up to end, which the runtime calls
+// with the ranges it hands its threads, see scheduler.cpp. Each range has a counter of its own, and
+// sees every other variable through ctx, an array of their addresses. A reduction(op: name) clause
+// gives each range its own name too, starting from op's identity, and combines them into name
+// atomically as the ranges finish, so only + * min and max can be reduced.
+
+// reduction(+: a, b), the operator being one of + * min max
+void Compiler::reduction_clause(vector<Reduction>* reductions) {
+    match(T_Reduction, "reduction");
+    lparen();
+    ReduceOp op;
+
+    if (token.type == TokenType::T_Plus) {
+        op = R_Add;
+    } else if (token.type == TokenType::T_Star) {
+        op = R_Multiply;
+    } else if ((token.type == TokenType::T_Ident) && (text == "min")) {
+        op = R_Min;
+    } else if ((token.type == TokenType::T_Ident) && (text == "max")) {
+        op = R_Max;
+    } else {
+        cerr << "Reductions are over +, *, min or max on line " << line << endl;
+        exit(1);
+    }
+
+    scan();
+    match(T_Colon, ":");
+
+    while (true) {
+        ident();
+        string name = text;
+
+        if (findglobal(name) == nullptr) {
+            cerr << "Unknown variable" << ":" << name << " on line " << line << endl;
+            exit(1);
+        }
+
+        if ((lengths.count(name)) || (pointers.count(name))) {
+            cerr << "Only int variables can be reduced on line " << line << endl;
+            exit(1);
+        }
+
+        for (Reduction& reduction : *reductions) {
+            if (reduction.name == name) {
+                cerr << name << " reduced twice on line " << line << endl;
+                exit(1);
+            }
+        }
+
+        reductions->push_back({op, name});
+
+        if (token.type != TokenType::T_Comma) {
+            break;
+        }
+
+        scan();
+    }
+
+    rparen();
+}
+
+// What a range's copy of a reduced variable starts from
+Constant* reduction_identity(IRBuilder<>* builder, ReduceOp op) {
+    switch (op) {
+        case R_Add:
+            return builder->getInt32(0);
+        case R_Multiply:
+            return builder->getInt32(1);
+        case R_Min:
+            return builder->getInt32(INT32_MAX);
+        case R_Max:
+            return builder->getInt32(INT32_MIN);
+    }
+
+    return nullptr;
+}
+
+// Folds a range's copy into the variable, other ranges may be doing the same at once
+void reduction_combine(IRBuilder<>* builder, ReduceOp op, Value* shared, Value* partial) {
+    AtomicRMWInst::BinOp rmw[] = {AtomicRMWInst::Add, AtomicRMWInst::BAD_BINOP, AtomicRMWInst::Min, AtomicRMWInst::Max};
+
+    if (op != R_Multiply) {
+        builder->CreateAtomicRMW(rmw[op], shared, partial, MaybeAlign(4), AtomicOrdering::Monotonic);
+        return;
+    }
+
+    // There's no atomic multiply, so it's compare and swap until no other range gets in between
+    BasicBlock* before = builder->GetInsertBlock();
+    BasicBlock* retry = BasicBlock::Create(builder->getContext(), "reduce.retry", before->getParent());
+    BasicBlock* after = BasicBlock::Create(builder->getContext(), "reduce.done", before->getParent());
+    LoadInst* seen = builder->CreateAlignedLoad(builder->getInt32Ty(), shared, MaybeAlign(4));
+    seen->setAtomic(AtomicOrdering::Monotonic);
+    builder->CreateBr(retry);
+
+    builder->SetInsertPoint(retry);
+    PHINode* expected = builder->CreatePHI(builder->getInt32Ty(), 2);
+    expected->addIncoming(seen, before);
+    Value* swapped = builder->CreateAtomicCmpXchg(shared, expected, builder->CreateMul(expected, partial), MaybeAlign(4), AtomicOrdering::Monotonic, AtomicOrdering::Monotonic);
+    expected->addIncoming(builder->CreateExtractValue(swapped, 0), retry);
+    builder->CreateCondBr(builder->CreateExtractValue(swapped, 1), after, retry);
+    builder->SetInsertPoint(after);
+}
+
+// The loop bodies outlined by the parallel fors in the block, and by those in them in turn
+void parallel_bodies(BasicBlock* block, vector<Function*>* bodies) {
+    for (Instruction& inst : *block) {
+        CallInst* call = dyn_cast<CallInst>(&inst);
+        Function* callee = call ? call->getCalledFunction() : nullptr;
+
+        if ((callee) && (callee->getName() == PARALLEL_NAME)) {
+            Function* body = cast<Function>(call->getArgOperand(0));
+            bodies->push_back(body);
+
+            for (BasicBlock& nested : *body) {
+                parallel_bodies(&nested, bodies);
+            }
+        }
+    }
+}
+
+void Compiler::parallel_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    int atLine = tokenLine;
+    int atColumn = tokenColumn;
+    match(T_Parallel, "parallel");
+    vector<Reduction> reductions;
+
+    while (token.type == TokenType::T_Reduction) {
+        reduction_clause(&reductions);
+    }
+
+    // Only a loop counting up by one can be cut into ranges up front
+    match(T_For, "for");
+    lparen();
+    ident();
+    string name = text;
+    Value* counter = findglobal(name);
+
+    if (counter == nullptr) {
+        cerr << "Undeclared variable" << ":" << name << " on line " << line << endl;
+        exit(1);
+    }
+
+    if ((lengths.count(name)) || (pointers.count(name))) {
+        cerr << "parallel for needs an int counter on line " << line << endl;
+        exit(1);
+    }
+
+    for (Reduction& reduction : reductions) {
+        if (reduction.name == name) {
+            cerr << "The counter of a parallel for can't be reduced on line " << line << endl;
+            exit(1);
+        }
+    }
+
+    auto malformed = [&]() {
+        cerr << "parallel for must count " << name << " up by one while " << name << " < end on line " << line << endl;
+        exit(1);
+    };
+
+    auto expect_counter = [&]() {
+        if ((token.type != TokenType::T_Ident) || (text != name)) {
+            malformed();
+        }
+
+        scan();
+    };
+
+    match(T_Assign, "=");
+    ASTNode* first = binexpr(0);
+    semi();
+    expect_counter();
+    match(T_LessThan, "<");
+    ASTNode* last = binexpr(0);
+    semi();
+    expect_counter();
+    match(T_Assign, "=");
+    expect_counter();
+    match(T_Plus, "+");
+
+    if ((token.type != TokenType::T_IntLit) || (token.intValue != 1)) {
+        malformed();
+    }
+
+    scan();
+    rparen();
+
+    // Both ends are worked out once, before any iteration runs
+    timer.enter(Ph_IRGen);
+    Value* begin = int_operand(buildAST(first, builder, context));
+    Value* end = int_operand(buildAST(last, builder, context));
+    timer.leave();
+    release(first);
+    release(last);
+
+    vector<Value*> shared;
+
+    for (Reduction& reduction : reductions) {
+        shared.push_back(findglobal(reduction.name));
+    }
+
+    Function* outer = builder->GetInsertBlock()->getParent();
+    Type* int_type = builder->getInt32Ty();
+    PointerType* ptr_type = builder->getInt8PtrTy();
+    FunctionType* body_type = FunctionType::get(builder->getVoidTy(), {int_type, int_type, ptr_type}, false);
+    Function* body = Function::Create(body_type, Function::InternalLinkage, outer->getName() + ".parallel", outer->getParent());
+    body->addFnAttr(Attribute::NoUnwind);
+    body->addParamAttr(2, Attribute::NoCapture);
+    body->addParamAttr(2, Attribute::ReadOnly);
+    debug_function(body, atLine);
+
+    BasicBlock* entry = BasicBlock::Create(*context, "entry", body);
+    IRBuilder<> body_builder(entry);
+    debug_location(&body_builder, atLine, atColumn);
+    DebugLoc at = body_builder.getCurrentDebugLocation();
+
+    // Variables declared in the body are its own, and break or return can't leave it
+    map<string, Value*> outerGlobals = globals;
+    map<string, unsigned> outerLengths = lengths;
+    map<string, Pointer> outerPointers = pointers;
+    map<string, size_t> outerDeclared = declared;
+    vector<BasicBlock*> outerBreaks;
+    swap(breaks, outerBreaks);
+    Function* outerBody = parallel_body;
+    parallel_body = body;
+
+    // The counter and the reduced variables are the range's own
+    AllocaInst* index = body_builder.CreateAlloca(int_type, nullptr, name);
+    globals[name] = index;
+    vector<AllocaInst*> partials;
+
+    for (Reduction& reduction : reductions) {
+        partials.push_back(body_builder.CreateAlloca(int_type, nullptr, reduction.name));
+        body_builder.CreateStore(reduction_identity(&body_builder, reduction.op), partials.back());
+        globals[reduction.name] = partials.back();
+    }
+
+    body_builder.CreateStore(body->getArg(0), index);
+
+    BasicBlock* header = new_block("parallel.header", entry);
+    BasicBlock* loop_body = new_block("parallel.body", header);
+    BasicBlock* latch = new_block("parallel.latch", loop_body);
+    BasicBlock* done = new_block("parallel.exit", latch);
+    body_builder.CreateBr(header);
+
+    body_builder.SetInsertPoint(header);
+    Value* current = body_builder.CreateLoad(int_type, index);
+    body_builder.CreateCondBr(body_builder.CreateICmpSLT(current, body->getArg(1)), loop_body, done);
+
+    body_builder.SetInsertPoint(loop_body);
+    single_statement(&body_builder, printf_type, printf_fn, context);
+    body_builder.CreateBr(latch);
+
+    body_builder.SetInsertPoint(latch);
+    body_builder.SetCurrentDebugLocation(at);
+    body_builder.CreateStore(body_builder.CreateAdd(body_builder.CreateLoad(int_type, index), body_builder.getInt32(1)), index);
+    body_builder.CreateBr(header);
+
+    body_builder.SetInsertPoint(done);
+
+    for (size_t i = 0; i < reductions.size(); i++) {
+        reduction_combine(&body_builder, reductions[i].op, shared[i], body_builder.CreateLoad(int_type, partials[i]));
+    }
+
+    body_builder.CreateRetVoid();
+
+    parallel_body = outerBody;
+    swap(breaks, outerBreaks);
+    globals = outerGlobals;
+    lengths = outerLengths;
+    pointers = outerPointers;
+    declared = outerDeclared;
+
+    // Whatever the body uses of the function around it is reached through ctx instead
+    SetVector<AllocaInst*> captured;
+
+    for (BasicBlock& block : *body) {
+        for (Instruction& inst : block) {
+            for (Value* operand : inst.operands()) {
+                AllocaInst* var = dyn_cast<AllocaInst>(operand);
+
+                if ((var) && (var->getFunction() != body)) {
+                    captured.insert(var);
+                }
+            }
+        }
+    }
+
+    IRBuilder<> prologue(entry, entry->begin());
+    Value* slots = prologue.CreateBitCast(body->getArg(2), ptr_type->getPointerTo());
+    size_t count = 0;
+
+    // Worker threads print through the context of the run() that started the loop, so its print callback
+    // is called from several threads at once, which run.h asks hosts to allow for
+    if (options.sharedObject) {
+        prologue.CreateStore(prologue.CreateLoad(ptr_type, slots), run_context);
+        count++;
+    }
+
+    for (AllocaInst* var : captured) {
+        Value* address = prologue.CreateLoad(ptr_type, prologue.CreateConstInBoundsGEP1_64(ptr_type, slots, count++));
+        Value* local = prologue.CreateBitCast(address, var->getType());
+
+        var->replaceUsesWithIf(local, [body](Use& use) {
+            return cast<Instruction>(use.getUser())->getFunction() == body;
+        });
+    }
+
+    verify(body);
+
+    timer.enter(Ph_IRGen);
+    Value* ctx = ConstantPointerNull::get(ptr_type);
+
+    if (count) {
+        BasicBlock* outer_entry = &outer->getEntryBlock();
+        IRBuilder<> entry_builder(outer_entry, outer_entry->getFirstInsertionPt());
+        ArrayType* ctx_type = ArrayType::get(ptr_type, count);
+        AllocaInst* addresses = entry_builder.CreateAlloca(ctx_type, nullptr, "parallel.ctx");
+        size_t slot = 0;
+
+        if (options.sharedObject) {
+            builder->CreateStore(builder->CreateLoad(ptr_type, run_context), builder->CreateConstInBoundsGEP2_64(ctx_type, addresses, 0, slot++));
+        }
+
+        for (AllocaInst* var : captured) {
+            builder->CreateStore(builder->CreateBitCast(var, ptr_type), builder->CreateConstInBoundsGEP2_64(ctx_type, addresses, 0, slot++));
+        }
+
+        ctx = builder->CreateBitCast(addresses, ptr_type);
+    }
+
+    Function* runtime = parallel_runtime(outer->getParent());
+    builder->CreateCall(runtime->getFunctionType(), runtime, {body, begin, end, ctx});
+
+    // The counter ends up where the loop would have left it
+    builder->CreateStore(builder->CreateSelect(builder->CreateICmpSLT(begin, end), end, begin), counter);
+    timer.leave();
+
+    // The threads may have stored to any variable the body sees
+    stored(nullptr);
+}
\ No newline at end of file
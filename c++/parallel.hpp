@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+using namespace std;
+
+// How a parallel for's reduction(op: name) clause combines what its iterations leave in name
+enum ReduceOp {
+    R_Add, R_Multiply, R_Min, R_Max
+};
+
+struct Reduction {
+    ReduceOp op;
+    string name;
+};
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "compiler.hpp"
+#include <string>
+#include <iostream>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/ADT/SmallVector.h>
+using namespace std;
+using namespace llvm;
+
+// Pointers are int* only, and restrict-qualified ones promise that what's accessed through them
+// isn't accessed any other way. Parameters pass that on as noalias, while locals get an alias
+// scope each so the accesses through them can be told apart from everything else.
+
+// The * and restrict after int, ahead of the name being declared
+Pointer Compiler::declarator() {
+    if (token.type == TokenType::T_Restrict) {
+        cerr << "restrict needs a pointer on line " << line << endl;
+        exit(1);
+    }
+
+    if (token.type != TokenType::T_Star) {
+        return P_None;
+    }
+
+    scan();
+
+    if (token.type == TokenType::T_Star) {
+        cerr << "Pointers to pointers aren't supported on line " << line << endl;
+        exit(1);
+    }
+
+    if (token.type != TokenType::T_Restrict) {
+        return P_Plain;
+    }
+
+    scan();
+    return P_Restrict;
+}
+
+// &x, &a[i] or &p[i], an array on its own is already the address of its first element
+ASTNode* Compiler::address() {
+    match(T_Amper, "&");
+
+    if (token.type != TokenType::T_Ident) {
+        cerr << "identifier expected on line " << line << endl;
+        exit(1);
+    }
+
+    string name = text;
+    Value* id = findglobal(name);
+
+    if (id == nullptr) {
+        cerr << "Unknown variable" << ":" << name << " on line " << line << endl;
+        exit(1);
+    }
+
+    scan();
+
+    if ((lengths.count(name)) && (token.type == TokenType::T_LBracket)) {
+        return index(ASTNodeOp::A_LVIndex, id);
+    }
+
+    if (pointers.count(name)) {
+        if (token.type != TokenType::T_LBracket) {
+            cerr << "Pointers to pointers aren't supported on line " << line << endl;
+            exit(1);
+        }
+
+        return pointer_element(id);
+    }
+
+    return mknode(ASTNodeOp::A_Addr, nullptr, nullptr, id);
+}
+
+// p[i] is *(p + i), this is the p + i
+ASTNode* Compiler::pointer_element(Value* ptr) {
+    lbracket();
+    ASTNode* at = binexpr(0);
+    rbracket();
+    return mknode(ASTNodeOp::A_Add, mknode(ASTNodeOp::A_Ident, nullptr, nullptr, ptr), at, 0);
+}
+
+Value* Compiler::int_operand(Value* val) {
+    if (val->getType()->isPointerTy()) {
+        cerr << "Pointer used where an int is expected on line " << line << endl;
+        exit(1);
+    }
+
+    return val;
+}
+
+Value* Compiler::address_of(IRBuilder<>* builder, Value* var) {
+    if (storage_type(var)->isArrayTy()) {
+        return element(builder, var, builder->getInt32(0));
+    }
+
+    return var;
+}
+
+// Pointer plus or minus an int steps over ints, two pointers subtract to the ints between them and
+// compare as addresses. Nothing else takes a pointer
+Value* Compiler::pointer_op(ASTNode* node, Value* leftVal, Value* rightVal, IRBuilder<>* builder) {
+    bool leftPointer = leftVal->getType()->isPointerTy();
+    bool rightPointer = rightVal->getType()->isPointerTy();
+    Type* int_type = builder->getInt32Ty();
+
+    if ((node->op == ASTNodeOp::A_Add) && (leftPointer != rightPointer)) {
+        Value* ptr = leftPointer ? leftVal : rightVal;
+        Value* offset = builder->CreateSExt(leftPointer ? rightVal : leftVal, builder->getInt64Ty());
+        return builder->CreateInBoundsGEP(int_type, ptr, offset);
+    }
+
+    if ((node->op == ASTNodeOp::A_Subtract) && (leftPointer) && (!rightPointer)) {
+        Value* offset = builder->CreateNeg(builder->CreateSExt(rightVal, builder->getInt64Ty()));
+        return builder->CreateInBoundsGEP(int_type, leftVal, offset);
+    }
+
+    if ((node->op == ASTNodeOp::A_Subtract) && (leftPointer) && (rightPointer)) {
+        return builder->CreateTrunc(builder->CreatePtrDiff(int_type, leftVal, rightVal), int_type);
+    }
+
+    CmpInst::Predicate predicate;
+
+    switch (node->op) {
+        case ASTNodeOp::A_Equal:
+            predicate = CmpInst::ICMP_EQ;
+            break;
+        case ASTNodeOp::A_NotEqual:
+            predicate = CmpInst::ICMP_NE;
+            break;
+        case ASTNodeOp::A_LessThan:
+            predicate = CmpInst::ICMP_ULT;
+            break;
+        case ASTNodeOp::A_GreaterThan:
+            predicate = CmpInst::ICMP_UGT;
+            break;
+        case ASTNodeOp::A_LessEqual:
+            predicate = CmpInst::ICMP_ULE;
+            break;
+        case ASTNodeOp::A_GreaterEqual:
+            predicate = CmpInst::ICMP_UGE;
+            break;
+        default:
+            cerr << "Invalid pointer arithmetic on line " << line << endl;
+            exit(1);
+    }
+
+    if (leftPointer != rightPointer) {
+        cerr << "Comparison between pointer and int on line " << line << endl;
+        exit(1);
+    }
+
+    return builder->CreateZExt(builder->CreateICmp(predicate, leftVal, rightVal), int_type);
+}
+
+// Gives a restrict-qualified local its scope, the first time its storage is seen
+void Compiler::restrict_scope(Value* var) {
+    if (scopes.count(var)) {
+        return;
+    }
+
+    MDBuilder md(var->getContext());
+
+    if (!scope_domain) {
+        scope_domain = md.createAnonymousAliasScopeDomain("restrict");
+    }
+
+    scopes.insert({var, md.createAnonymousAliasScope(scope_domain, var->getName())});
+}
+
+// An access through a restrict-qualified local is in its scope and outside the others, a variable
+// accessed by name is outside all of them. Through any other pointer it could be any of them
+void Compiler::alias_metadata(Instruction* access, Value* address) {
+    if (scopes.empty()) {
+        return;
+    }
+
+    Value* base = getUnderlyingObject(address);
+    Value* var = isa<LoadInst>(base) ? cast<LoadInst>(base)->getPointerOperand() : nullptr;
+    auto found = var ? scopes.find(var) : scopes.end();
+
+    if ((found == scopes.end()) && (!isa<AllocaInst>(base)) && (!isa<GlobalVariable>(base))) {
+        return;
+    }
+
+    LLVMContext& ctx = access->getContext();
+    SmallVector<Metadata*, 8> outside;
+
+    for (auto& scope : scopes) {
+        if (scope.first != var) {
+            outside.push_back(scope.second);
+        }
+    }
+
+    if (found != scopes.end()) {
+        access->setMetadata(LLVMContext::MD_alias_scope, MDNode::get(ctx, {found->second}));
+    }
+
+    if (!outside.empty()) {
+        access->setMetadata(LLVMContext::MD_noalias, MDNode::get(ctx, outside));
+    }
+}
\ No newline at end of file
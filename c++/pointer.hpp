@@ -0,0 +1,6 @@
+#pragma once
+
+// What the * and restrict between int and a name make of it
+enum Pointer {
+    P_None, P_Plain, P_Restrict
+};
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+// What a program compiled with -shared exports. The host dlopens it once and calls run as often
+// as it likes, from as many threads as it likes. Every print statement calls ctx->print with the
+// context run was given, so hosts can put their own state after the callback. A parallel for runs
+// its body on worker threads that print through the same ctx, so print must be thread-safe even
+// when only one run is in progress, and prints from a parallel body arrive in no fixed order.
+
+typedef struct RunContext {
+    void (*print)(struct RunContext* ctx, int value);
+} RunContext;
+
+#ifdef __cplusplus
+extern "C"
+#endif
+int run(void* ctx);
\ No newline at end of file
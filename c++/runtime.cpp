@@ -0,0 +1,196 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Module.h>
+using namespace std;
+using namespace llvm;
+
+// -ffreestanding-runtime programs don't link libc. The process starts at _start, which calls main
+// and exits through exit_group, and print statements format into a buffer of our own that goes
+// out with write whenever it fills up and at exit.
+
+const char* PRINT_NAME = "rt.print";
+const uint64_t OUTPUT_BUFFER_SIZE = 4096;
+
+// Longest line print writes, "-2147483648\n"
+const uint64_t LONGEST_PRINT = 12;
+
+const uint64_t SYS_WRITE = 1;
+const uint64_t SYS_EXIT_GROUP = 231;
+
+// A Linux x86-64 system call, which clobbers rcx and r11 on the way back
+Value* syscall(IRBuilder<>* builder, uint64_t number, vector<Value*> args) {
+    const char* registers[] = {"{di}", "{si}", "{dx}"};
+    string constraints = "={ax},{ax}";
+    vector<Type*> types = {builder->getInt64Ty()};
+    vector<Value*> operands = {builder->getInt64(number)};
+
+    for (size_t i = 0; i < args.size(); i++) {
+        constraints += string(",") + registers[i];
+        types.push_back(args[i]->getType());
+        operands.push_back(args[i]);
+    }
+
+    constraints += ",~{rcx},~{r11},~{memory}";
+    FunctionType* type = FunctionType::get(builder->getInt64Ty(), types, false);
+    return builder->CreateCall(type, InlineAsm::get(type, "syscall", constraints, true), operands);
+}
+
+// The function print statements call: printf, or without libc the runtime's own printer
+Function* Compiler::declare_print(Module* mod) {
+    LLVMContext& ctx = mod->getContext();
+
+    if (!options.freestanding) {
+        Type* printf_arg_types[] = {Type::getInt8PtrTy(ctx)};
+        FunctionType* printf_type = FunctionType::get(Type::getInt32Ty(ctx), printf_arg_types, true);
+        return Function::Create(printf_type, Function::ExternalLinkage, "printf", mod);
+    }
+
+    FunctionType* print_type = FunctionType::get(Type::getVoidTy(ctx), {Type::getInt32Ty(ctx)}, false);
+    Function* print_fn = Function::Create(print_type, Function::ExternalLinkage, PRINT_NAME, mod);
+    print_fn->setVisibility(GlobalValue::HiddenVisibility);
+    print_fn->addFnAttr(Attribute::NoUnwind);
+    return print_fn;
+}
+
+// Defines the runtime in the main module, filling in the printer setup() declared
+void Compiler::freestanding_runtime(Module* mod) {
+    LLVMContext& ctx = mod->getContext();
+    IRBuilder<> builder(ctx);
+    Type* size_type = builder.getInt64Ty();
+    Type* void_type = builder.getVoidTy();
+    ArrayType* buffer_type = ArrayType::get(builder.getInt8Ty(), OUTPUT_BUFFER_SIZE);
+
+    GlobalVariable* buffer = new GlobalVariable(*mod, buffer_type, false, GlobalValue::InternalLinkage, Constant::getNullValue(buffer_type), "rt.buffer");
+    GlobalVariable* used = new GlobalVariable(*mod, size_type, false, GlobalValue::InternalLinkage, builder.getInt64(0), "rt.used");
+
+    auto runtime_function = [&](FunctionType* type, string name) {
+        Function* fn = Function::Create(type, Function::InternalLinkage, name, mod);
+        fn->addFnAttr(Attribute::NoUnwind);
+        return fn;
+    };
+
+    auto byte_at = [&](Value* at) {
+        return builder.CreateInBoundsGEP(buffer_type, buffer, {builder.getInt64(0), at});
+    };
+
+    // rt.flush writes out the buffer, a short write carrying on from where it stopped
+    Function* flush = runtime_function(FunctionType::get(void_type, false), "rt.flush");
+    BasicBlock* entry = BasicBlock::Create(ctx, "entry", flush);
+    BasicBlock* loop = BasicBlock::Create(ctx, "loop", flush);
+    BasicBlock* write = BasicBlock::Create(ctx, "write", flush);
+    BasicBlock* done = BasicBlock::Create(ctx, "done", flush);
+
+    builder.SetInsertPoint(entry);
+    Value* length = builder.CreateLoad(size_type, used);
+    builder.CreateBr(loop);
+
+    builder.SetInsertPoint(loop);
+    PHINode* offset = builder.CreatePHI(size_type, 2);
+    offset->addIncoming(builder.getInt64(0), entry);
+    builder.CreateCondBr(builder.CreateICmpULT(offset, length), write, done);
+
+    builder.SetInsertPoint(write);
+    Value* written = syscall(&builder, SYS_WRITE, {builder.getInt64(1), byte_at(offset), builder.CreateSub(length, offset)});
+    offset->addIncoming(builder.CreateAdd(offset, written), write);
+
+    // Nowhere to report a failed write, so the rest of the output is dropped
+    builder.CreateCondBr(builder.CreateICmpSGT(written, builder.getInt64(0)), loop, done);
+
+    builder.SetInsertPoint(done);
+    builder.CreateStore(builder.getInt64(0), used);
+    builder.CreateRetVoid();
+
+    // rt.print appends the number and a newline, counting its digits first to write them backwards
+    Function* print = printf_func;
+    print->setLinkage(options.streamBatch ? Function::ExternalLinkage : Function::InternalLinkage);
+    entry = BasicBlock::Create(ctx, "entry", print);
+    BasicBlock* full = BasicBlock::Create(ctx, "full", print);
+    BasicBlock* count = BasicBlock::Create(ctx, "count", print);
+    BasicBlock* digits = BasicBlock::Create(ctx, "digits", print);
+    BasicBlock* sign = BasicBlock::Create(ctx, "sign", print);
+    BasicBlock* minus = BasicBlock::Create(ctx, "minus", print);
+    BasicBlock* end = BasicBlock::Create(ctx, "end", print);
+
+    builder.SetInsertPoint(entry);
+    Value* start = builder.CreateLoad(size_type, used);
+    builder.CreateCondBr(builder.CreateICmpUGT(start, builder.getInt64(OUTPUT_BUFFER_SIZE - LONGEST_PRINT)), full, count);
+
+    builder.SetInsertPoint(full);
+    builder.CreateCall(flush->getFunctionType(), flush);
+    builder.CreateBr(count);
+
+    // Widened first, so negating the most negative int doesn't overflow
+    builder.SetInsertPoint(count);
+    PHINode* from = builder.CreatePHI(size_type, 2);
+    from->addIncoming(start, entry);
+    from->addIncoming(builder.getInt64(0), full);
+    Value* number = builder.CreateSExt(print->getArg(0), size_type);
+    Value* negative = builder.CreateICmpSLT(number, builder.getInt64(0));
+    Value* magnitude = builder.CreateSelect(negative, builder.CreateNeg(number), number);
+
+    Value* width = builder.CreateZExt(negative, size_type);
+    uint64_t power = 1;
+
+    for (int i = 0; i < 10; i++) {
+        width = builder.CreateAdd(width, builder.CreateZExt(builder.CreateICmpUGE(magnitude, builder.getInt64(power)), size_type));
+        power *= 10;
+    }
+
+    // Zero still has a digit
+    width = builder.CreateAdd(width, builder.CreateZExt(builder.CreateICmpEQ(magnitude, builder.getInt64(0)), size_type));
+    Value* newline = builder.CreateAdd(from, width);
+    builder.CreateBr(digits);
+
+    builder.SetInsertPoint(digits);
+    PHINode* rest = builder.CreatePHI(size_type, 2);
+    PHINode* at = builder.CreatePHI(size_type, 2);
+    rest->addIncoming(magnitude, count);
+    at->addIncoming(newline, count);
+    Value* before = builder.CreateSub(at, builder.getInt64(1));
+    Value* digit = builder.CreateTrunc(builder.CreateURem(rest, builder.getInt64(10)), builder.getInt8Ty());
+    builder.CreateStore(builder.CreateAdd(digit, builder.getInt8('0')), byte_at(before));
+    Value* next = builder.CreateUDiv(rest, builder.getInt64(10));
+    rest->addIncoming(next, digits);
+    at->addIncoming(before, digits);
+    builder.CreateCondBr(builder.CreateICmpNE(next, builder.getInt64(0)), digits, sign);
+
+    builder.SetInsertPoint(sign);
+    builder.CreateCondBr(negative, minus, end);
+
+    builder.SetInsertPoint(minus);
+    builder.CreateStore(builder.getInt8('-'), byte_at(from));
+    builder.CreateBr(end);
+
+    builder.SetInsertPoint(end);
+    builder.CreateStore(builder.getInt8('\n'), byte_at(newline));
+    builder.CreateStore(builder.CreateAdd(newline, builder.getInt64(1)), used);
+    builder.CreateRetVoid();
+
+    // _start gets the stack 16-byte aligned rather than just past a return address, so it realigns
+    // it. There's no libc to hand over argc and argv, main gets none
+    Function* start_fn = Function::Create(FunctionType::get(void_type, false), Function::ExternalLinkage, "_start", mod);
+    start_fn->addFnAttr(Attribute::NoUnwind);
+    start_fn->addFnAttr(Attribute::NoReturn);
+    start_fn->addFnAttr("stackrealign");
+    builder.SetInsertPoint(BasicBlock::Create(ctx, "entry", start_fn));
+
+    Value* main_args[] = {builder.getInt32(0), Constant::getNullValue(main_function->getArg(1)->getType())};
+    CallInst* status = builder.CreateCall(main_function->getFunctionType(), main_function, main_args);
+
+    // Inlined main would carry its debug locations into a function that has none
+    status->addFnAttr(Attribute::NoInline);
+    builder.CreateCall(flush->getFunctionType(), flush);
+    syscall(&builder, SYS_EXIT_GROUP, {builder.CreateSExt(status, size_type)});
+    builder.CreateUnreachable();
+
+    verify(flush);
+    verify(print);
+    verify(start_fn);
+}
\ No newline at end of file
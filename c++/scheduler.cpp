@@ -0,0 +1,356 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/AtomicOrdering.h>
+using namespace std;
+using namespace llvm;
+
+// The runtime parallel for calls, defined in each module that has one. rt.parallel_for starts a
+// thread for every core but the one it's called on and splits the iterations evenly between them
+// all. Each worker claims a few iterations at a time from the front of its range, and one that runs
+// out steals the back half of someone else's, so the cores stay busy however uneven the iterations
+// are. A range is two 32-bit offsets packed into a word, so the owner claiming from one end and
+// thieves cutting off the other agree with a compare and swap, without any locks. The threads are
+// joined before it returns, which also makes everything they stored visible to the caller.
+// $PARALLEL_WORKERS sets how many workers there are.
+
+const char* PARALLEL_NAME = "rt.parallel_for";
+const uint64_t MAX_WORKERS = 64;
+
+// Each worker claims its range in about this many pieces, few enough that claiming costs nothing
+// next to the iterations, and enough that whoever finishes last doesn't hold up the others long
+const uint64_t CLAIMS_PER_WORKER = 16;
+
+// sysconf's name for the number of processors online, on Linux
+const int SC_NPROCESSORS_ONLN = 84;
+
+Function* Compiler::parallel_runtime(Module* mod) {
+    if (Function* fn = mod->getFunction(PARALLEL_NAME)) {
+        return fn;
+    }
+
+    LLVMContext& ctx = mod->getContext();
+    IRBuilder<> builder(ctx);
+    Type* int_type = builder.getInt32Ty();
+    Type* word_type = builder.getInt64Ty();
+    PointerType* ptr_type = builder.getInt8PtrTy();
+    FunctionType* body_type = FunctionType::get(builder.getVoidTy(), {int_type, int_type, ptr_type}, false);
+
+    auto runtime_function = [&](FunctionType* type, string name) {
+        Function* fn = Function::Create(type, Function::InternalLinkage, name, mod);
+        fn->addFnAttr(Attribute::NoUnwind);
+        return fn;
+    };
+
+    // rt.parallel_for(body, begin, end, ctx) runs body(from, to, ctx) over ranges covering begin up to end
+    Function* parallel = runtime_function(FunctionType::get(builder.getVoidTy(), {body_type->getPointerTo(), int_type, int_type, ptr_type}, false), PARALLEL_NAME);
+    Value* body = parallel->getArg(0);
+    Value* begin = parallel->getArg(1);
+    Value* end = parallel->getArg(2);
+    Value* body_ctx = parallel->getArg(3);
+    BasicBlock* entry = BasicBlock::Create(ctx, "entry", parallel);
+
+    // Without libc there are no threads, so the caller runs every iteration
+    if (options.freestanding) {
+        BasicBlock* run = BasicBlock::Create(ctx, "run", parallel);
+        BasicBlock* done = BasicBlock::Create(ctx, "done", parallel);
+
+        builder.SetInsertPoint(entry);
+        builder.CreateCondBr(builder.CreateICmpSLT(begin, end), run, done);
+
+        builder.SetInsertPoint(run);
+        builder.CreateCall(body_type, body, {begin, end, body_ctx});
+        builder.CreateBr(done);
+
+        builder.SetInsertPoint(done);
+        builder.CreateRetVoid();
+        verify(parallel);
+        return parallel;
+    }
+
+    // Ranges go a cache line apart, so one worker claiming doesn't slow down the others
+    ArrayType* line_type = ArrayType::get(word_type, 8);
+    ArrayType* ranges_type = ArrayType::get(line_type, MAX_WORKERS);
+
+    // What the workers share: the body, its ctx, the first iteration, how many workers there are,
+    // how many iterations a claim takes, and each worker's range as offsets from the first iteration
+    StructType* state_type = StructType::create(ctx, {body_type->getPointerTo(), ptr_type, int_type, word_type, word_type, ranges_type}, "rt.state");
+
+    // What a thread starts with, the state and which worker it is
+    StructType* task_type = StructType::create(ctx, {state_type->getPointerTo(), word_type}, "rt.task");
+
+    FunctionType* thread_type = FunctionType::get(ptr_type, {ptr_type}, false);
+    FunctionCallee create = mod->getOrInsertFunction("pthread_create", FunctionType::get(int_type, {word_type->getPointerTo(), ptr_type, thread_type->getPointerTo(), ptr_type}, false));
+    FunctionCallee join = mod->getOrInsertFunction("pthread_join", FunctionType::get(int_type, {word_type, ptr_type->getPointerTo()}, false));
+    FunctionCallee getenv_fn = mod->getOrInsertFunction("getenv", FunctionType::get(ptr_type, {ptr_type}, false));
+    FunctionCallee atoi_fn = mod->getOrInsertFunction("atoi", FunctionType::get(int_type, {ptr_type}, false));
+    FunctionCallee sysconf_fn = mod->getOrInsertFunction("sysconf", FunctionType::get(builder.getInt64Ty(), {int_type}, false));
+
+    // The ranges only hand out iteration numbers, so relaxed atomics do for them
+    auto load_range = [&](Value* at) {
+        LoadInst* load = builder.CreateAlignedLoad(word_type, at, MaybeAlign(8));
+        load->setAtomic(AtomicOrdering::Monotonic);
+        return load;
+    };
+
+    auto swap_range = [&](Value* at, Value* expected, Value* desired) {
+        return builder.CreateExtractValue(builder.CreateAtomicCmpXchg(at, expected, desired, MaybeAlign(8), AtomicOrdering::Monotonic, AtomicOrdering::Monotonic), 1);
+    };
+
+    auto pack = [&](Value* from, Value* to) {
+        return builder.CreateOr(from, builder.CreateShl(to, 32));
+    };
+
+    auto low = [&](Value* range) {
+        return builder.CreateAnd(range, builder.getInt64(UINT32_MAX));
+    };
+
+    auto high = [&](Value* range) {
+        return builder.CreateLShr(range, 32);
+    };
+
+    auto range_at = [&](Value* state, Value* worker) {
+        return builder.CreateInBoundsGEP(state_type, state, {builder.getInt32(0), builder.getInt32(5), worker, builder.getInt64(0)});
+    };
+
+    // rt.workers is $PARALLEL_WORKERS or else the number of cores, worked out once
+    GlobalVariable* known = new GlobalVariable(*mod, int_type, false, GlobalValue::InternalLinkage, builder.getInt32(0), "rt.worker_count");
+    Function* workers = runtime_function(FunctionType::get(int_type, false), "rt.workers");
+    BasicBlock* workers_entry = BasicBlock::Create(ctx, "entry", workers);
+    BasicBlock* cached = BasicBlock::Create(ctx, "cached", workers);
+    BasicBlock* lookup = BasicBlock::Create(ctx, "lookup", workers);
+    BasicBlock* asked = BasicBlock::Create(ctx, "asked", workers);
+    BasicBlock* cores = BasicBlock::Create(ctx, "cores", workers);
+    BasicBlock* clamp = BasicBlock::Create(ctx, "clamp", workers);
+
+    builder.SetInsertPoint(workers_entry);
+    LoadInst* count = builder.CreateAlignedLoad(int_type, known, MaybeAlign(4));
+    count->setAtomic(AtomicOrdering::Monotonic);
+    builder.CreateCondBr(builder.CreateICmpNE(count, builder.getInt32(0)), cached, lookup);
+
+    builder.SetInsertPoint(cached);
+    builder.CreateRet(count);
+
+    builder.SetInsertPoint(lookup);
+    Value* setting = builder.CreateCall(getenv_fn, {builder.CreateGlobalStringPtr("PARALLEL_WORKERS", "rt.workers_name")});
+    builder.CreateCondBr(builder.CreateIsNull(setting), cores, asked);
+
+    builder.SetInsertPoint(asked);
+    Value* wanted = builder.CreateCall(atoi_fn, {setting});
+    builder.CreateCondBr(builder.CreateICmpSGT(wanted, builder.getInt32(0)), clamp, cores);
+
+    builder.SetInsertPoint(cores);
+    Value* online = builder.CreateTrunc(builder.CreateCall(sysconf_fn, {builder.getInt32(SC_NPROCESSORS_ONLN)}), int_type);
+    builder.CreateBr(clamp);
+
+    builder.SetInsertPoint(clamp);
+    PHINode* chosen = builder.CreatePHI(int_type, 2);
+    chosen->addIncoming(wanted, asked);
+    chosen->addIncoming(online, cores);
+    Value* atLeast = builder.CreateSelect(builder.CreateICmpSLT(chosen, builder.getInt32(1)), builder.getInt32(1), chosen);
+    Value* atMost = builder.CreateSelect(builder.CreateICmpSGT(atLeast, builder.getInt32(MAX_WORKERS)), builder.getInt32(MAX_WORKERS), atLeast);
+    builder.CreateAlignedStore(atMost, known, MaybeAlign(4))->setAtomic(AtomicOrdering::Monotonic);
+    builder.CreateRet(atMost);
+
+    // rt.worker claims from its own range until it's empty, then looks for one to steal half of,
+    // and is done once every other range is down to the iteration its owner is on
+    Function* worker = runtime_function(thread_type, "rt.worker");
+    BasicBlock* worker_entry = BasicBlock::Create(ctx, "entry", worker);
+    BasicBlock* claim = BasicBlock::Create(ctx, "claim", worker);
+    BasicBlock* take = BasicBlock::Create(ctx, "take", worker);
+    BasicBlock* run = BasicBlock::Create(ctx, "run", worker);
+    BasicBlock* steal = BasicBlock::Create(ctx, "steal", worker);
+    BasicBlock* search = BasicBlock::Create(ctx, "search", worker);
+    BasicBlock* probe = BasicBlock::Create(ctx, "probe", worker);
+    BasicBlock* look = BasicBlock::Create(ctx, "look", worker);
+    BasicBlock* split = BasicBlock::Create(ctx, "split", worker);
+    BasicBlock* stolen = BasicBlock::Create(ctx, "stolen", worker);
+    BasicBlock* next_victim = BasicBlock::Create(ctx, "next", worker);
+    BasicBlock* finished = BasicBlock::Create(ctx, "finished", worker);
+
+    builder.SetInsertPoint(worker_entry);
+    Value* task = builder.CreateBitCast(worker->getArg(0), task_type->getPointerTo());
+    Value* state = builder.CreateLoad(state_type->getPointerTo(), builder.CreateStructGEP(task_type, task, 0));
+    Value* id = builder.CreateLoad(word_type, builder.CreateStructGEP(task_type, task, 1));
+    Value* work = builder.CreateLoad(body_type->getPointerTo(), builder.CreateStructGEP(state_type, state, 0));
+    Value* work_ctx = builder.CreateLoad(ptr_type, builder.CreateStructGEP(state_type, state, 1));
+    Value* first = builder.CreateLoad(int_type, builder.CreateStructGEP(state_type, state, 2));
+    Value* worker_count = builder.CreateLoad(word_type, builder.CreateStructGEP(state_type, state, 3));
+    Value* grain = builder.CreateLoad(word_type, builder.CreateStructGEP(state_type, state, 4));
+    Value* own = range_at(state, id);
+    builder.CreateBr(claim);
+
+    builder.SetInsertPoint(claim);
+    Value* range = load_range(own);
+    Value* from = low(range);
+    Value* to = high(range);
+    builder.CreateCondBr(builder.CreateICmpULT(from, to), take, steal);
+
+    builder.SetInsertPoint(take);
+    Value* upto = builder.CreateSelect(builder.CreateICmpULT(builder.CreateSub(to, from), grain), to, builder.CreateAdd(from, grain));
+    builder.CreateCondBr(swap_range(own, range, pack(upto, to)), run, claim);
+
+    builder.SetInsertPoint(run);
+    builder.CreateCall(body_type, work, {builder.CreateAdd(first, builder.CreateTrunc(from, int_type)), builder.CreateAdd(first, builder.CreateTrunc(upto, int_type)), work_ctx});
+    builder.CreateBr(claim);
+
+    builder.SetInsertPoint(steal);
+    builder.CreateBr(search);
+
+    // Victims are tried in turn, starting with the next worker along
+    builder.SetInsertPoint(search);
+    PHINode* step = builder.CreatePHI(word_type, 2);
+    step->addIncoming(builder.getInt64(1), steal);
+    builder.CreateCondBr(builder.CreateICmpULT(step, worker_count), probe, finished);
+
+    builder.SetInsertPoint(probe);
+    Value* victim = range_at(state, builder.CreateURem(builder.CreateAdd(id, step), worker_count));
+    builder.CreateBr(look);
+
+    // A range of one iteration is left to its owner, who's about to take it anyway
+    builder.SetInsertPoint(look);
+    Value* theirs = load_range(victim);
+    Value* theirFrom = low(theirs);
+    Value* theirTo = high(theirs);
+    builder.CreateCondBr(builder.CreateICmpUGT(theirTo, builder.CreateAdd(theirFrom, builder.getInt64(1))), split, next_victim);
+
+    builder.SetInsertPoint(split);
+    Value* middle = builder.CreateSub(theirTo, builder.CreateLShr(builder.CreateSub(theirTo, theirFrom), 1));
+    builder.CreateCondBr(swap_range(victim, theirs, pack(theirFrom, middle)), stolen, look);
+
+    // No one else touches an empty range, so the stolen half can simply be stored as ours
+    builder.SetInsertPoint(stolen);
+    builder.CreateAlignedStore(pack(middle, theirTo), own, MaybeAlign(8))->setAtomic(AtomicOrdering::Monotonic);
+    builder.CreateBr(claim);
+
+    builder.SetInsertPoint(next_victim);
+    step->addIncoming(builder.CreateAdd(step, builder.getInt64(1)), next_victim);
+    builder.CreateBr(search);
+
+    // What the bodies counted on this thread goes into the program's counts before the thread ends
+    builder.SetInsertPoint(finished);
+
+    if (options.instrument) {
+        merge_counters(&builder);
+    }
+
+    builder.CreateRet(ConstantPointerNull::get(ptr_type));
+
+    // rt.parallel_for sets up the ranges, starts the threads and works alongside them. The workers of
+    // threads that couldn't be started are run by the caller too, since the last iteration of a range
+    // is only ever taken by its own worker
+    BasicBlock* setup = BasicBlock::Create(ctx, "setup", parallel);
+    BasicBlock* fill = BasicBlock::Create(ctx, "fill", parallel);
+    BasicBlock* start = BasicBlock::Create(ctx, "start", parallel);
+    BasicBlock* spawn = BasicBlock::Create(ctx, "spawn", parallel);
+    BasicBlock* spawned = BasicBlock::Create(ctx, "spawned", parallel);
+    BasicBlock* share = BasicBlock::Create(ctx, "share", parallel);
+    BasicBlock* orphans = BasicBlock::Create(ctx, "orphans", parallel);
+    BasicBlock* adopt = BasicBlock::Create(ctx, "adopt", parallel);
+    BasicBlock* joining = BasicBlock::Create(ctx, "joining", parallel);
+    BasicBlock* joined = BasicBlock::Create(ctx, "joined", parallel);
+    BasicBlock* done = BasicBlock::Create(ctx, "done", parallel);
+
+    builder.SetInsertPoint(entry);
+    Value* shared = builder.CreateAlloca(state_type, nullptr, "state");
+    Value* tasks = builder.CreateAlloca(ArrayType::get(task_type, MAX_WORKERS), nullptr, "tasks");
+    Value* threads = builder.CreateAlloca(ArrayType::get(word_type, MAX_WORKERS), nullptr, "threads");
+    builder.CreateCondBr(builder.CreateICmpSLT(begin, end), setup, done);
+
+    // At most as many workers as iterations, each claim at least one
+    builder.SetInsertPoint(setup);
+    Value* iterations = builder.CreateSub(builder.CreateSExt(end, word_type), builder.CreateSExt(begin, word_type));
+    Value* available = builder.CreateZExt(builder.CreateCall(workers->getFunctionType(), workers), word_type);
+    Value* used = builder.CreateSelect(builder.CreateICmpULT(iterations, available), iterations, available);
+    Value* piece = builder.CreateUDiv(iterations, builder.CreateMul(used, builder.getInt64(CLAIMS_PER_WORKER)));
+    Value* claimed = builder.CreateSelect(builder.CreateICmpEQ(piece, builder.getInt64(0)), builder.getInt64(1), piece);
+    builder.CreateStore(body, builder.CreateStructGEP(state_type, shared, 0));
+    builder.CreateStore(body_ctx, builder.CreateStructGEP(state_type, shared, 1));
+    builder.CreateStore(begin, builder.CreateStructGEP(state_type, shared, 2));
+    builder.CreateStore(used, builder.CreateStructGEP(state_type, shared, 3));
+    builder.CreateStore(claimed, builder.CreateStructGEP(state_type, shared, 4));
+    builder.CreateBr(fill);
+
+    builder.SetInsertPoint(fill);
+    PHINode* slot = builder.CreatePHI(word_type, 2);
+    slot->addIncoming(builder.getInt64(0), setup);
+    Value* following = builder.CreateAdd(slot, builder.getInt64(1));
+    Value* lower = builder.CreateUDiv(builder.CreateMul(iterations, slot), used);
+    Value* upper = builder.CreateUDiv(builder.CreateMul(iterations, following), used);
+    builder.CreateStore(pack(lower, upper), range_at(shared, slot));
+    slot->addIncoming(following, fill);
+    builder.CreateCondBr(builder.CreateICmpULT(following, used), fill, start);
+
+    builder.SetInsertPoint(start);
+    builder.CreateBr(spawn);
+
+    builder.SetInsertPoint(spawn);
+    PHINode* thread = builder.CreatePHI(word_type, 2);
+    thread->addIncoming(builder.getInt64(1), start);
+    BasicBlock* create_block = BasicBlock::Create(ctx, "create", parallel, spawned);
+    builder.CreateCondBr(builder.CreateICmpULT(thread, used), create_block, share);
+
+    auto task_at = [&](Value* at) {
+        return builder.CreateInBoundsGEP(ArrayType::get(task_type, MAX_WORKERS), tasks, {builder.getInt64(0), at});
+    };
+
+    auto start_task = [&](Value* at) {
+        Value* slot_task = task_at(at);
+        builder.CreateStore(shared, builder.CreateStructGEP(task_type, slot_task, 0));
+        builder.CreateStore(at, builder.CreateStructGEP(task_type, slot_task, 1));
+        return builder.CreateBitCast(slot_task, ptr_type);
+    };
+
+    builder.SetInsertPoint(create_block);
+    Value* handle = builder.CreateInBoundsGEP(ArrayType::get(word_type, MAX_WORKERS), threads, {builder.getInt64(0), thread});
+    Value* status = builder.CreateCall(create, {handle, ConstantPointerNull::get(ptr_type), worker, start_task(thread)});
+    builder.CreateCondBr(builder.CreateICmpEQ(status, builder.getInt32(0)), spawned, share);
+
+    builder.SetInsertPoint(spawned);
+    thread->addIncoming(builder.CreateAdd(thread, builder.getInt64(1)), spawned);
+    builder.CreateBr(spawn);
+
+    // Threads from 1 up to the first that didn't start are running
+    builder.SetInsertPoint(share);
+    PHINode* running = builder.CreatePHI(word_type, 2);
+    running->addIncoming(thread, spawn);
+    running->addIncoming(thread, create_block);
+    builder.CreateCall(thread_type, worker, {start_task(builder.getInt64(0))});
+    builder.CreateBr(orphans);
+
+    // Then those from the first that didn't start up to the last
+    builder.SetInsertPoint(orphans);
+    PHINode* orphan = builder.CreatePHI(word_type, 2);
+    orphan->addIncoming(running, share);
+    builder.CreateCondBr(builder.CreateICmpULT(orphan, used), adopt, joining);
+
+    builder.SetInsertPoint(adopt);
+    builder.CreateCall(thread_type, worker, {start_task(orphan)});
+    orphan->addIncoming(builder.CreateAdd(orphan, builder.getInt64(1)), adopt);
+    builder.CreateBr(orphans);
+
+    builder.SetInsertPoint(joining);
+    PHINode* waiting = builder.CreatePHI(word_type, 2);
+    waiting->addIncoming(builder.getInt64(1), orphans);
+    builder.CreateCondBr(builder.CreateICmpULT(waiting, running), joined, done);
+
+    builder.SetInsertPoint(joined);
+    Value* joinHandle = builder.CreateInBoundsGEP(ArrayType::get(word_type, MAX_WORKERS), threads, {builder.getInt64(0), waiting});
+    builder.CreateCall(join, {builder.CreateLoad(word_type, joinHandle), ConstantPointerNull::get(ptr_type->getPointerTo())});
+    waiting->addIncoming(builder.CreateAdd(waiting, builder.getInt64(1)), joined);
+    builder.CreateBr(joining);
+
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+
+    verify(workers);
+    verify(worker);
+    verify(parallel);
+    return parallel;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "compiler.hpp"
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Module.h>
+using namespace std;
+using namespace llvm;
+
+// -shared builds the program as int run(void* ctx) in a position-independent shared object. Its
+// variables live in run's frame, so any number of calls can be running at once, and print
+// statements call the function pointer at the start of ctx instead of printf, see run.h. Workers of
+// a parallel for take the context over from the thread that started it, so they print through it too.
+
+const char* RUN_NAME = "run";
+
+// Context of the innermost run() on this thread, for print statements in the program's functions
+const char* CONTEXT_NAME = "run.context";
+
+// Makes run's context the one its thread prints to, keeping any outer call's to put back after
+void Compiler::enter_run() {
+    PointerType* ptr_type = Type::getInt8PtrTy(*context);
+    IRBuilder<> builder(&main_function->getEntryBlock());
+    run_context = new GlobalVariable(*module, ptr_type, false, GlobalValue::InternalLinkage, Constant::getNullValue(ptr_type), CONTEXT_NAME, nullptr, GlobalValue::GeneralDynamicTLSModel);
+    outer_context = builder.CreateLoad(ptr_type, run_context);
+    builder.CreateStore(main_function->getArg(0), run_context);
+}
+
+void Compiler::leave_run(IRBuilder<>* builder) {
+    builder->CreateStore(outer_context, run_context);
+}
+
+// ctx->print(ctx, val), where run itself has ctx at hand and functions it calls look it up
+void Compiler::print_callback(IRBuilder<>* builder, Value* val) {
+    PointerType* ptr_type = builder->getInt8PtrTy();
+    Function* fn = builder->GetInsertBlock()->getParent();
+    Value* ctx = (fn == main_function) ? (Value*)main_function->getArg(0) : builder->CreateLoad(ptr_type, run_context);
+
+    FunctionType* print_type = FunctionType::get(builder->getVoidTy(), {ptr_type, builder->getInt32Ty()}, false);
+    PointerType* callback_type = print_type->getPointerTo();
+    Value* callback = builder->CreateLoad(callback_type, builder->CreateBitCast(ctx, callback_type->getPointerTo()));
+    builder->CreateCall(print_type, callback, {ctx, val});
+}
\ No newline at end of file
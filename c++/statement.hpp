@@ -0,0 +1,17 @@
+#pragma once
+#include <llvm/IR/BasicBlock.h>
+#include <cstddef>
+using namespace std;
+using namespace llvm;
+
+// A top-level statement remembered between incremental rebuilds
+struct Statement {
+    size_t begin;               // Source offset just past the previous statement
+    size_t end;                 // Source offset just past the statement's last token
+    int line;                   // Line number at end
+    bool declaration;           // Declarations change the symbol table
+    BasicBlock* entry;          // First of the statement's blocks, the rest follow it up to the next statement
+    BasicBlock* exit;           // Block control falls out of
+
+    Statement(size_t begin) : begin(begin), end(begin), line(0), declaration(false), entry(nullptr), exit(nullptr) {}
+};
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "stats.hpp"
+#include "astNode.hpp"
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <sys/resource.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/FileSystem.h>
+using namespace std;
+using namespace llvm;
+
+#ifdef COUNT_ALLOCATIONS
+atomic<size_t> allocations(0);
+atomic<size_t> allocatedBytes(0);
+
+void* counted_alloc(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    return p;
+}
+
+void* operator new(size_t size) {
+    void* p = counted_alloc(size);
+
+    if (!p) {
+        throw bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+bool heap_counted() {
+    return true;
+}
+
+size_t heap_allocations() {
+    return allocations.load(memory_order_relaxed);
+}
+
+size_t heap_bytes() {
+    return allocatedBytes.load(memory_order_relaxed);
+}
+#else
+bool heap_counted() {
+    return false;
+}
+
+size_t heap_allocations() {
+    return 0;
+}
+
+size_t heap_bytes() {
+    return 0;
+}
+#endif
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void Stats::report(raw_ostream& out) {
+    auto row = [&out](string name, string value) {
+        out << "  " << left_justify(name, 28) << right_justify(value, 16) << "\n";
+    };
+
+    out << "===" << string(73, '-') << "===\n";
+    out << string(31, ' ') << "Compiler statistics\n";
+    out << "===" << string(73, '-') << "===\n";
+    row("Tokens lexed", to_string(tokens));
+    row("AST nodes allocated", to_string(astCounters.allocated));
+    row("Peak AST bytes", to_string(astCounters.peak * sizeof(ASTNode)));
+    row("AST nodes shared", to_string(sharedNodes));
+    row("Symbol table entries", to_string(symbols));
+    row("IR values reused", to_string(reusedValues));
+    row("IR instructions emitted", to_string(instructions));
+    row("Heap allocations", heap_counted() ? to_string(heap_allocations()) : "n/a");
+    row("Heap bytes allocated", heap_counted() ? to_string(heap_bytes()) : "n/a");
+    row("Peak RSS (KB)", to_string(peak_rss_kb()));
+    row("Object files", to_string(objects));
+    row("Object bytes", to_string(objectBytes));
+    out << "\n";
+    out.flush();
+}
+
+void Stats::write_json(string filename) {
+    error_code EC;
+    raw_fd_ostream dest(filename, EC, sys::fs::OF_Text);
+
+    if (EC) {
+        cerr << "Could not open file: " << EC.message() << endl;
+        exit(1);
+    }
+
+    json::OStream json(dest, 2);
+    json.object([&]() {
+        json.attribute("tokens", (int64_t)tokens);
+        json.attribute("ast_nodes", (int64_t)astCounters.allocated);
+        json.attribute("peak_ast_bytes", (int64_t)(astCounters.peak * sizeof(ASTNode)));
+        json.attribute("ast_nodes_shared", (int64_t)sharedNodes);
+        json.attribute("symbols", (int64_t)symbols);
+        json.attribute("ir_values_reused", (int64_t)reusedValues);
+        json.attribute("ir_instructions", (int64_t)instructions);
+
+        if (heap_counted()) {
+            json.attribute("heap_allocations", (int64_t)heap_allocations());
+            json.attribute("heap_bytes", (int64_t)heap_bytes());
+        } else {
+            json.attribute("heap_allocations", nullptr);
+            json.attribute("heap_bytes", nullptr);
+        }
+
+        json.attribute("peak_rss_kb", (int64_t)peak_rss_kb());
+        json.attribute("objects", (int64_t)objects);
+        json.attribute("object_bytes", (int64_t)objectBytes);
+    });
+    dest << "\n";
+}
\ No newline at end of file
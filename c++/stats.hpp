@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <llvm/Support/raw_ostream.h>
+using namespace std;
+using namespace llvm;
+
+// Counters behind --stats
+struct Stats {
+    size_t tokens;          // Tokens lexed, not counting EOF
+    size_t symbols;         // Variables declared
+    size_t sharedNodes;     // Expressions found in the --dag table instead of allocated
+    size_t reusedValues;    // Shared nodes whose IR was reused rather than built again
+    size_t instructions;    // IR instructions handed to code generation
+    size_t objects;         // Object files written
+    size_t objectBytes;     // Their combined size
+
+    Stats() : tokens(0), symbols(0), sharedNodes(0), reusedValues(0), instructions(0), objects(0), objectBytes(0) {}
+
+    void report(raw_ostream& out);
+    void write_json(string filename);
+};
+
+// Heap use seen by the global operator new, only counted in builds with COUNT_ALLOCATIONS
+bool heap_counted();
+size_t heap_allocations();
+size_t heap_bytes();
\ No newline at end of file
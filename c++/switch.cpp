@@ -0,0 +1,157 @@
+#include "compiler.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <cstdint>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+using namespace std;
+using namespace llvm;
+
+// Ranges up to this many values become a case each, which leaves the backend free to pick a jump
+// table, bit test or decision tree for them. Wider ones are tested on their own once no case matched
+const int64_t CASE_RANGE_LIMIT = 64;
+
+// A case lo ... hi: too wide to list
+struct CaseRange {
+    int64_t lo;
+    int64_t hi;
+    BasicBlock* label;
+};
+
+// A case label's value, which has to be known at compile time
+int64_t Compiler::case_value(IRBuilder<>* builder, LLVMContext* context) {
+    ASTNode* tree = binexpr(0);
+    Value* val = buildAST(tree, builder, context);
+    release(tree);
+
+    if (!isa<ConstantInt>(val)) {
+        cerr << "case label must be a constant on line " << line << endl;
+        exit(1);
+    }
+
+    return cast<ConstantInt>(val)->getSExtValue();
+}
+
+// switch (x) { case 1: ... case 2 ... 4: ... default: ... }, each case falling through into the
+// next unless it breaks. Every label starts a block, and the switch instruction jumps to them
+void Compiler::switch_statement(IRBuilder<>* builder, FunctionType* printf_type, Function* printf_fn, LLVMContext* context) {
+    match(T_Switch, "switch");
+    lparen();
+    ASTNode* tree = binexpr(0);
+    rparen();
+
+    timer.enter(Ph_IRGen);
+    Value* cond = int_operand(buildAST(tree, builder, context));
+    timer.leave();
+    release(tree);
+
+    DebugLoc at = builder->getCurrentDebugLocation();
+    BasicBlock* start = builder->GetInsertBlock();
+    BasicBlock* end = new_block("switch.exit", start);
+    SwitchInst* inst = builder->CreateSwitch(cond, end);
+    BasicBlock* fallback = nullptr;
+    vector<CaseRange> ranges;
+
+    // The values already taken, each run of them from its first to its last
+    map<int64_t, int64_t> covered;
+
+    // Statements ahead of the first label can't be reached
+    builder->SetInsertPoint(new_block("switch.body", start));
+    breaks.push_back(end);
+    lbrace();
+
+    while (token.type != TokenType::T_RBrace) {
+        if ((token.type != TokenType::T_Case) && (token.type != TokenType::T_Default)) {
+            if (!single_statement(builder, printf_type, printf_fn, context)) {
+                cerr << "} expected on line " << line << endl;
+                exit(1);
+            }
+
+            continue;
+        }
+
+        // The code before a label falls through into it
+        BasicBlock* label = new_block("switch.case", builder->GetInsertBlock());
+
+        if (!builder->GetInsertBlock()->getTerminator()) {
+            builder->CreateBr(label);
+        }
+
+        builder->SetInsertPoint(label);
+
+        if (token.type == TokenType::T_Default) {
+            if (fallback) {
+                cerr << "Second default label on line " << line << endl;
+                exit(1);
+            }
+
+            scan();
+            match(T_Colon, ":");
+            fallback = label;
+            continue;
+        }
+
+        scan();
+        timer.enter(Ph_IRGen);
+        int64_t lo = case_value(builder, context);
+        int64_t hi = lo;
+
+        if (token.type == TokenType::T_Ellipsis) {
+            scan();
+            hi = case_value(builder, context);
+        }
+
+        timer.leave();
+        match(T_Colon, ":");
+
+        if (hi < lo) {
+            cerr << "Empty case range on line " << line << endl;
+            exit(1);
+        }
+
+        auto after = covered.upper_bound(hi);
+
+        if ((after != covered.begin()) && (prev(after)->second >= lo)) {
+            cerr << "Duplicate case value on line " << line << endl;
+            exit(1);
+        }
+
+        covered[lo] = hi;
+
+        if (hi - lo < CASE_RANGE_LIMIT) {
+            for (int64_t val = lo; val <= hi; val++) {
+                inst->addCase(builder->getInt32((uint32_t)val), label);
+            }
+        } else {
+            ranges.push_back({lo, hi, label});
+        }
+    }
+
+    rbrace();
+    breaks.pop_back();
+
+    // The last case falls out of the switch
+    if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(end);
+    }
+
+    // Values no case matched are checked against each wide range in turn, then go to the default
+    BasicBlock* unmatched = fallback ? fallback : end;
+
+    for (auto range = ranges.rbegin(); range != ranges.rend(); range++) {
+        BasicBlock* test = new_block("switch.range", start);
+        IRBuilder<> range_builder(test);
+        range_builder.SetCurrentDebugLocation(at);
+        Value* offset = range_builder.CreateSub(cond, range_builder.getInt32((uint32_t)range->lo));
+        Value* inside = range_builder.CreateICmpULE(offset, range_builder.getInt32((uint32_t)(range->hi - range->lo)));
+        range_builder.CreateCondBr(inside, range->label, unmatched);
+        unmatched = test;
+    }
+
+    inst->setDefaultDest(unmatched);
+    builder->SetInsertPoint(end);
+}
\ No newline at end of file
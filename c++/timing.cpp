@@ -0,0 +1,35 @@
+#include "timing.hpp"
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+using namespace std;
+using namespace llvm;
+
+const char* phaseNames[] = {
+    "Setup", "Lexing", "Parsing", "IR generation", "Verification", "Optimization", "Code generation", "Linking"
+};
+
+void PhaseTimer::report(raw_ostream& out) {
+    if (!enabled) {
+        return;
+    }
+
+    double total = 0;
+
+    for (int i = 0; i < Ph_Count; i++) {
+        total += seconds[i];
+    }
+
+    // Same layout as LLVM's own timer reports, which follow it
+    out << "===" << string(73, '-') << "===\n";
+    out << string(27, ' ') << "Compiler phase timing report\n";
+    out << "===" << string(73, '-') << "===\n";
+    out << "  Total Execution Time: " << format("%5.4f", total) << " seconds\n\n";
+    out << "   ---Wall Time---  --- Name ---\n";
+
+    for (int i = 0; i < Ph_Count; i++) {
+        out << format("   %7.4f (%5.1f%%)  ", seconds[i], (total > 0) ? seconds[i] * 100 / total : 0.0) << phaseNames[i] << "\n";
+    }
+
+    out << format("   %7.4f (100.0%%)  ", total) << "Total\n\n";
+    out.flush();
+}
\ No newline at end of file
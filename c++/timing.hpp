@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <llvm/Support/raw_ostream.h>
+using namespace std;
+using namespace llvm;
+
+enum Phase {
+    Ph_Setup, Ph_Lex, Ph_Parse, Ph_IRGen, Ph_Verify, Ph_Optimize, Ph_CodeGen, Ph_Link,
+    Ph_Count
+};
+
+// Wall time spent in each phase of the compiler, not counting phases nested inside it
+class PhaseTimer {
+private:
+    bool enabled;
+    vector<Phase> active;
+    chrono::steady_clock::time_point last;
+    double seconds[Ph_Count];
+
+    void charge() {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+        if (!active.empty()) {
+            seconds[active.back()] += chrono::duration<double>(now - last).count();
+        }
+
+        last = now;
+    }
+public:
+    PhaseTimer() : enabled(false), seconds() {}
+
+    void enable() {
+        enabled = true;
+    }
+
+    void enter(Phase phase) {
+        if (enabled) {
+            charge();
+            active.push_back(phase);
+        }
+    }
+
+    void leave() {
+        if (enabled) {
+            charge();
+            active.pop_back();
+        }
+    }
+
+    bool is_enabled() {
+        return enabled;
+    }
+
+    double elapsed(Phase phase) {
+        return seconds[phase];
+    }
+
+    // Takes time measured on its own back off a phase that was charged for it too
+    void deduct(Phase phase, double s) {
+        seconds[phase] -= min(s, seconds[phase]);
+    }
+
+    void report(raw_ostream& out);
+};
+
+struct PhaseScope {
+    PhaseTimer& timer;
+
+    PhaseScope(PhaseTimer& timer, Phase phase) : timer(timer) {
+        timer.enter(phase);
+    }
+
+    ~PhaseScope() {
+        timer.leave();
+    }
+};
\ No newline at end of file
@@ -7,6 +7,11 @@ enum TokenType {
     T_Equal, T_NotEqual,
     T_LessThan, T_GreaterThan, T_LessEqual, T_GreaterEqual,
     T_IntLit, T_Semi, T_Assign, T_Ident,
+    T_LBrace, T_RBrace, T_LParen, T_RParen, T_LBracket, T_RBracket, T_Comma, T_Pragma, T_Amper,
+    T_Colon, T_Ellipsis,
     // Keywords
-    T_Print, T_Int
+    T_Print, T_Int, T_While, T_For, T_Return,
+    T_If, T_Else, T_Likely, T_Unlikely, T_Restrict,
+    T_Switch, T_Case, T_Default, T_Break,
+    T_Parallel, T_Reduction
 };
\ No newline at end of file
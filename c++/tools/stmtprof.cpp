@@ -0,0 +1,108 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+using namespace std;
+
+// Prints the statement counts a program built with --instrument-statements wrote at exit
+
+void usage(char* prog) {
+    cerr << "Usage: " << prog << " [--top=N] profile [source]" << endl;
+    cerr << "  --top=N                       Only the N most executed lines, hottest first" << endl;
+    exit(1);
+}
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+};
+
+int main(int argc, char* argv[]) {
+    size_t top = 0;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg.rfind("--top=", 0) == 0) {
+            top = atol(arg.substr(6).c_str());
+
+            if (top == 0) {
+                usage(argv[0]);
+            }
+        } else if ((arg[0] == '-') || (files.size() == 2)) {
+            usage(argv[0]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        usage(argv[0]);
+    }
+
+    ifstream inFile(files[0], ios::binary);
+    Header header;
+
+    if ((!inFile.read((char*)&header, sizeof(header))) || (memcmp(header.magic, "STMTPROF", 8) != 0) || (header.version != 1)) {
+        cerr << "Not a statement profile: " << files[0] << endl;
+        exit(1);
+    }
+
+    vector<uint32_t> lines(header.count);
+    vector<uint64_t> counts(header.count);
+    inFile.read((char*)lines.data(), header.count * sizeof(uint32_t));
+    inFile.read((char*)counts.data(), header.count * sizeof(uint64_t));
+
+    if (!inFile) {
+        cerr << "Truncated statement profile: " << files[0] << endl;
+        exit(1);
+    }
+
+    // Statements sharing a line are reported together
+    map<uint32_t, uint64_t> byLine;
+
+    for (uint32_t i = 0; i < header.count; i++) {
+        byLine[lines[i]] += counts[i];
+    }
+
+    vector<string> source;
+
+    if (files.size() > 1) {
+        ifstream srcFile(files[1]);
+        string text;
+
+        while (getline(srcFile, text)) {
+            source.push_back(text);
+        }
+    }
+
+    vector<pair<uint32_t, uint64_t>> rows(byLine.begin(), byLine.end());
+
+    if (top) {
+        stable_sort(rows.begin(), rows.end(), [](const pair<uint32_t, uint64_t>& a, const pair<uint32_t, uint64_t>& b) {
+            return a.second > b.second;
+        });
+        rows.resize(min(top, rows.size()));
+    }
+
+    for (auto& row : rows) {
+        printf("%8u %16llu", row.first, (unsigned long long)row.second);
+
+        if ((row.first >= 1) && (row.first <= source.size())) {
+            printf("  %s", source[row.first - 1].c_str());
+        }
+
+        printf("\n");
+    }
+
+    return 0;
+}
\ No newline at end of file
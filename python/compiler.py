@@ -6,13 +6,15 @@ from ctoken import Token
 from tokentype import TokenType
 from astnodeop import ASTNodeOp
 from astnode import ASTNode
+import frontend
 
 TextLen = 512
 NumSymbols = 1024
 
 class Compiler:
-    def __init__(self, filename):
+    def __init__(self, filename, native=True):
         self.inFile = open(filename, 'r')
+        self.frontend = frontend.load() if native else None
         self.line = 1
         self.putback = '\n'
         self.token = Token(TokenType.T_EOF, 0)
@@ -471,6 +473,25 @@ class Compiler:
     
     def parse(self):
         node = self.compound_statement()
+        self.generate(node)
+
+    def parse_native(self):
+        tree = frontend.Tree(self.frontend, self.inFile.read().encode())
+
+        if tree.error != None:
+            print(tree.error, file=sys.stderr)
+            tree.close()
+            sys.exit(1)
+
+        # Every variable gets its alloca in the entry block, as the Python parser does
+        for name in tree.symbols():
+            self.addglobal(name)
+            tree.values.append(self.globals[name])
+
+        self.generate(tree.root())
+        tree.close()
+
+    def generate(self, node):
         self.buildAST(node, None)
         retval = self.builder.alloca(ir.IntType(32))
         self.builder.store(ir.Constant(retval.type.pointee, 0), retval)
@@ -492,6 +513,10 @@ class Compiler:
         outFile.close()
 
     def run(self):
-        self.scan()
-        self.parse()
+        if self.frontend != None:
+            self.parse_native()
+        else:
+            self.scan()
+            self.parse()
+
         self.inFile.close()
\ No newline at end of file
@@ -0,0 +1,97 @@
+import os
+from ctypes import cdll, Structure, POINTER, c_int32, c_size_t, c_char_p, c_void_p, string_at
+from astnodeop import ASTNodeOp
+
+# Native lexer and parser from c++/frontend. The compiler uses it whenever it has been
+# built with `make -C c++`, reading its tokens and nodes straight out of the library's arrays.
+Library = os.environ.get('CCOMPILER_FRONTEND', os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'c++', 'build', 'libfrontend.so'))
+
+class FrontToken(Structure):
+    _fields_ = [('type', c_int32), ('line', c_int32), ('value', c_int32)]
+
+class FrontNode(Structure):
+    _fields_ = [('op', c_int32), ('left', c_int32), ('mid', c_int32), ('right', c_int32), ('value', c_int32), ('line', c_int32)]
+
+class FrontResult(Structure):
+    _fields_ = [
+        ('tokens', POINTER(FrontToken)),
+        ('tokenCount', c_int32),
+        ('nodes', POINTER(FrontNode)),
+        ('nodeCount', c_int32),
+        ('root', c_int32),
+        ('text', c_void_p),
+        ('textLength', c_int32),
+        ('symbols', POINTER(c_int32)),
+        ('symbolCount', c_int32),
+        ('error', c_char_p),
+    ]
+
+def load():
+    if not os.path.exists(Library):
+        return None
+
+    lib = cdll.LoadLibrary(Library)
+    lib.front_parse.argtypes = [c_char_p, c_size_t]
+    lib.front_parse.restype = POINTER(FrontResult)
+    lib.front_free.argtypes = [POINTER(FrontResult)]
+    lib.front_free.restype = None
+    return lib
+
+class Tree:
+    def __init__(self, lib, source):
+        self.lib = lib
+        self.result = lib.front_parse(source, len(source))
+        self.contents = self.result.contents
+        self.nodes = self.contents.nodes
+        self.tokens = self.contents.tokens
+        self.error = None if self.contents.error == None else self.contents.error.decode()
+        self.values = []
+
+    def name(self, offset):
+        return string_at(self.contents.text + offset).decode()
+
+    def symbols(self):
+        return [self.name(self.contents.symbols[i]) for i in range(self.contents.symbolCount)]
+
+    def node(self, index):
+        return None if index < 0 else NodeView(self, index)
+
+    def root(self):
+        return self.node(self.contents.root)
+
+    def close(self):
+        self.lib.front_free(self.result)
+
+# Looks like an ASTNode to buildAST, but reads the library's node in place. Identifiers
+# evaluate to whatever the compiler put in the tree's values for their symbol.
+class NodeView:
+    __slots__ = ('tree', 'index')
+
+    def __init__(self, tree, index):
+        self.tree = tree
+        self.index = index
+
+    @property
+    def op(self):
+        return ASTNodeOp(self.tree.nodes[self.index].op)
+
+    @property
+    def left(self):
+        return self.tree.node(self.tree.nodes[self.index].left)
+
+    @property
+    def mid(self):
+        return self.tree.node(self.tree.nodes[self.index].mid)
+
+    @property
+    def right(self):
+        return self.tree.node(self.tree.nodes[self.index].right)
+
+    @property
+    def value(self):
+        node = self.tree.nodes[self.index]
+
+        if (node.op == ASTNodeOp.Ident.value) or (node.op == ASTNodeOp.LVIdent.value):
+            return self.tree.values[node.value]
+
+        return node.value
\ No newline at end of file
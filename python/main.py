@@ -2,14 +2,22 @@ import sys
 from compiler import Compiler
 
 def usage(prog):
-    print('Usage: %s infile' % prog, file=sys.stderr)
+    print('Usage: %s [--python-frontend] infile' % prog, file=sys.stderr)
     sys.exit(1)
 
 def main():
-    if len(sys.argv) != 2:
+    args = sys.argv[1:]
+    native = True
+
+    # The native front end is used when it's been built, unless asked not to
+    if (len(args) == 2) and (args[0] == '--python-frontend'):
+        native = False
+        args = args[1:]
+
+    if len(args) != 1:
         usage(sys.argv[0])
     
-    compiler = Compiler(sys.argv[1])
+    compiler = Compiler(args[0], native)
     compiler.run()
 
 if __name__ == '__main__':